@@ -0,0 +1,446 @@
+#include "AnalysisServer.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+// A client socket; replies from several workers are serialized by the mutex
+struct AnalysisServer::Connection {
+	int fd;
+	std::mutex writeMutex;
+
+	Connection(int fd) : fd(fd) {}
+
+	~Connection() {
+		close(fd);
+	}
+
+	void send(const std::string& line) {
+		std::lock_guard<std::mutex> lock(writeMutex);
+		size_t sent = 0;
+		while (sent < line.size()) {
+			ssize_t written = ::send(fd, line.data() + sent, line.size() - sent, MSG_NOSIGNAL);
+			if (written <= 0) {
+				return;
+			}
+			sent += written;
+		}
+	}
+};
+
+// One analysis request, queued until a worker picks it up
+struct AnalysisServer::Job {
+	std::shared_ptr<Connection> connection;
+	std::string id; // raw JSON value, echoed back in the reply
+	Board position;
+	long long moveTime; // -1: no limit
+	unsigned long long nodes; // 0: no limit
+	int depth;
+	SearchInfo info;
+	std::atomic<bool> cancelled;
+};
+
+
+// Splits a flat JSON object into keys and raw values; nested objects and arrays are not supported
+static bool parseObject(const std::string& line, std::vector<std::pair<std::string, std::string>>& fields) {
+	size_t i = 0;
+	auto skipSpace = [&]() {
+		while (i < line.size() && isspace((unsigned char)line[i])) {
+			i++;
+		}
+	};
+	// Raw extent of a string token starting at i, quotes included
+	auto scanString = [&]() {
+		size_t start = i++;
+		while (i < line.size() && line[i] != '"') {
+			i += line[i] == '\\' ? 2 : 1;
+		}
+		if (i >= line.size()) {
+			return std::string();
+		}
+		i++;
+		return line.substr(start, i - start);
+	};
+
+	skipSpace();
+	if (i >= line.size() || line[i++] != '{') {
+		return false;
+	}
+	skipSpace();
+	if (i < line.size() && line[i] == '}') {
+		return true;
+	}
+	while (i < line.size()) {
+		skipSpace();
+		if (i >= line.size() || line[i] != '"') {
+			return false;
+		}
+		std::string key = scanString();
+		if (key.empty()) {
+			return false;
+		}
+		skipSpace();
+		if (i >= line.size() || line[i++] != ':') {
+			return false;
+		}
+		skipSpace();
+		std::string value;
+		if (i < line.size() && line[i] == '"') {
+			value = scanString();
+		}
+		else {
+			size_t start = i;
+			while (i < line.size() && line[i] != ',' && line[i] != '}' && !isspace((unsigned char)line[i])) {
+				i++;
+			}
+			value = line.substr(start, i - start);
+		}
+		if (value.empty() || value[0] == '{' || value[0] == '[') {
+			return false;
+		}
+		fields.emplace_back(key.substr(1, key.size() - 2), value);
+		skipSpace();
+		if (i < line.size() && line[i] == ',') {
+			i++;
+			continue;
+		}
+		return i < line.size() && line[i] == '}';
+	}
+	return false;
+}
+
+// Contents of a raw JSON string value with the common escapes resolved; other values are returned as they are
+static std::string unquote(const std::string& raw) {
+	if (raw.size() < 2 || raw[0] != '"') {
+		return raw;
+	}
+	std::string result;
+	for (size_t i = 1; i + 1 < raw.size(); i++) {
+		if (raw[i] != '\\') {
+			result += raw[i];
+			continue;
+		}
+		char c = raw[++i];
+		result += c == 'n' ? '\n' : c == 't' ? '\t' : c;
+	}
+	return result;
+}
+
+static std::string errorReply(const std::string& id, const char* message) {
+	return "{\"id\": " + id + ", \"error\": \"" + message + "\"}\n";
+}
+
+
+AnalysisServer::AnalysisServer(TranspositionTable* table, int workers, size_t queueCapacity) {
+	this->table = table;
+	this->workers = std::max(1, workers);
+	this->queueCapacity = std::max<size_t>(1, queueCapacity);
+	listener = -1;
+	shuttingDown = false;
+}
+
+AnalysisServer::~AnalysisServer() {
+	if (listener >= 0) {
+		close(listener);
+	}
+	if (!socketPath.empty()) {
+		unlink(socketPath.c_str());
+	}
+}
+
+// Binds "unix:<path>" or "tcp:<port>" (127.0.0.1 only); returns false with a message printed on failure
+bool AnalysisServer::listen(const std::string& address) {
+	if (address.compare(0, 5, "unix:") == 0) {
+		sockaddr_un name;
+		std::memset(&name, 0, sizeof(name));
+		name.sun_family = AF_UNIX;
+		std::string path = address.substr(5);
+		if (path.empty() || path.size() >= sizeof(name.sun_path)) {
+			printf("Invalid socket path: %s\n", path.c_str());
+			return false;
+		}
+		std::strcpy(name.sun_path, path.c_str());
+		unlink(path.c_str());
+
+		listener = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (listener < 0 || bind(listener, (sockaddr*)&name, sizeof(name)) < 0) {
+			printf("Could not bind %s: %s\n", path.c_str(), strerror(errno));
+			return false;
+		}
+		socketPath = path;
+	}
+	else if (address.compare(0, 4, "tcp:") == 0) {
+		int port = atoi(address.c_str() + 4);
+		if (port <= 0 || port > 65535) {
+			printf("Invalid port: %s\n", address.c_str() + 4);
+			return false;
+		}
+		sockaddr_in name;
+		std::memset(&name, 0, sizeof(name));
+		name.sin_family = AF_INET;
+		name.sin_port = htons(port);
+		name.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		listener = socket(AF_INET, SOCK_STREAM, 0);
+		int reuse = 1;
+		if (listener >= 0) {
+			setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+		}
+		if (listener < 0 || bind(listener, (sockaddr*)&name, sizeof(name)) < 0) {
+			printf("Could not bind port %d: %s\n", port, strerror(errno));
+			return false;
+		}
+	}
+	else {
+		printf("Address must be unix:<path> or tcp:<port>\n");
+		return false;
+	}
+
+	if (::listen(listener, 64) < 0) {
+		printf("Could not listen: %s\n", strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+// Accepts connections and serves requests until a shutdown request arrives
+void AnalysisServer::run() {
+	std::vector<std::thread> workerThreads;
+	for (int i = 0; i < workers; i++) {
+		workerThreads.emplace_back(&AnalysisServer::workerLoop, this);
+	}
+
+	// poll with a timeout so that a shutdown request is noticed
+	pollfd listening = { listener, POLLIN, 0 };
+	while (!shuttingDown) {
+		if (poll(&listening, 1, 100) <= 0) {
+			continue;
+		}
+		int fd = accept(listener, nullptr, nullptr);
+		if (fd < 0) {
+			continue;
+		}
+		auto connection = std::make_shared<Connection>(fd);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			connections.push_back(connection);
+		}
+		std::thread(&AnalysisServer::serveConnection, this, connection).detach();
+	}
+
+	cancelAll(nullptr);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto& connection : connections) {
+			shutdown(connection->fd, SHUT_RDWR);
+		}
+	}
+	jobReady.notify_all();
+	for (std::thread& thread : workerThreads) {
+		thread.join();
+	}
+
+	// readers remove their connection when they finish
+	std::unique_lock<std::mutex> lock(mutex);
+	connectionClosed.wait(lock, [this] { return connections.empty(); });
+}
+
+// Reads requests from one client until it disconnects
+void AnalysisServer::serveConnection(std::shared_ptr<Connection> connection) {
+	std::string buffer;
+	char chunk[4096];
+	while (true) {
+		ssize_t received = recv(connection->fd, chunk, sizeof(chunk), 0);
+		if (received <= 0) {
+			break;
+		}
+		buffer.append(chunk, received);
+
+		size_t start = 0, end;
+		while ((end = buffer.find('\n', start)) != std::string::npos) {
+			handleRequest(connection, buffer.substr(start, end - start));
+			start = end + 1;
+		}
+		buffer.erase(0, start);
+		if (buffer.size() > 65536) {
+			connection->send(errorReply("null", "request too long"));
+			break;
+		}
+	}
+
+	// nobody is left to read the replies
+	cancelAll(connection.get());
+	std::lock_guard<std::mutex> lock(mutex);
+	connections.erase(std::remove(connections.begin(), connections.end(), connection), connections.end());
+	connectionClosed.notify_all();
+}
+
+// Handles one request line
+void AnalysisServer::handleRequest(const std::shared_ptr<Connection>& connection, const std::string& line) {
+	if (line.find_first_not_of(" \t\r") == std::string::npos) {
+		return;
+	}
+	std::vector<std::pair<std::string, std::string>> fields;
+	if (!parseObject(line, fields)) {
+		connection->send(errorReply("null", "malformed request"));
+		return;
+	}
+
+	auto job = std::make_shared<Job>();
+	job->connection = connection;
+	job->id = "null";
+	job->moveTime = -1;
+	job->nodes = 0;
+	job->depth = 64;
+	job->cancelled = false;
+	std::string fen, cancel;
+	bool shutdownRequested = false;
+	for (auto& field : fields) {
+		const std::string& key = field.first;
+		const std::string& value = field.second;
+		if (key == "id") {
+			if (value.size() > 256) {
+				connection->send(errorReply("null", "id too long"));
+				return;
+			}
+			job->id = value;
+		}
+		else if (key == "fen") {
+			fen = unquote(value);
+		}
+		else if (key == "movetime") {
+			job->moveTime = atoll(value.c_str());
+		}
+		else if (key == "nodes") {
+			job->nodes = strtoull(value.c_str(), nullptr, 10);
+		}
+		else if (key == "depth") {
+			job->depth = std::max(1, std::min(64, atoi(value.c_str())));
+		}
+		else if (key == "cancel") {
+			cancel = value;
+		}
+		else if (key == "shutdown") {
+			shutdownRequested = value == "true";
+		}
+	}
+
+	if (shutdownRequested) {
+		shuttingDown = true;
+		return;
+	}
+
+	if (!cancel.empty()) {
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto it = queue.begin(); it != queue.end(); ++it) {
+			if ((*it)->connection == connection && (*it)->id == cancel) {
+				connection->send(errorReply(cancel, "cancelled"));
+				queue.erase(it);
+				return;
+			}
+		}
+		for (auto& active : running) {
+			if (active->connection == connection && active->id == cancel) {
+				active->cancelled = true;
+				active->info.stop = true;
+			}
+		}
+		return;
+	}
+
+	FenResult result = job->position.parseFEN(fen);
+	if (!result.ok()) {
+		connection->send(errorReply(job->id, result.message()));
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (queue.size() >= queueCapacity) {
+			connection->send(errorReply(job->id, "queue full"));
+			return;
+		}
+		queue.push_back(job);
+	}
+	jobReady.notify_one();
+}
+
+// Searches queued jobs until shutdown
+void AnalysisServer::workerLoop() {
+	PositionHistory history;
+	while (true) {
+		std::shared_ptr<Job> job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobReady.wait(lock, [this] { return shuttingDown || !queue.empty(); });
+			if (queue.empty()) {
+				return;
+			}
+			job = queue.front();
+			queue.pop_front();
+
+			// limits count from the start of the search, not from when the request was queued; set up before the job
+			// becomes visible to cancel so that a stop arriving now isn't cleared
+			SearchInfo& info = job->info;
+			info.reset();
+			info.table = table;
+			info.nodeLimit = job->nodes;
+			if (job->moveTime >= 0) {
+				info.deadline = info.startTime + std::max(1LL, job->moveTime);
+			}
+			running.push_back(job);
+		}
+
+		SearchInfo& info = job->info;
+		table->newSearch();
+		Board position = job->position;
+		position.history = &history;
+		position.searchInfo = &info;
+		Move bestMove;
+		// cancel and cancelAll may have stopped the job between the lock above and here
+		if (!job->cancelled && !info.stop) {
+			position.iterativeDeepening(bestMove, job->depth);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			running.erase(std::find(running.begin(), running.end(), job));
+		}
+
+		char reply[2048], moveString[6];
+		int length = snprintf(reply, sizeof(reply), "{\"id\": %s", job->id.c_str());
+		if (info.pvLength == 0) {
+			length += snprintf(reply + length, sizeof(reply) - length, ", \"bestmove\": null");
+		}
+		else {
+			position.moveToString(info.pv[0], moveString);
+			length += snprintf(reply + length, sizeof(reply) - length, ", \"bestmove\": \"%s\"", moveString);
+		}
+		length += snprintf(reply + length, sizeof(reply) - length, ", \"score\": %.2f, \"depth\": %d, \"nodes\": %llu, \"time\": %lld, \"pv\": [",
+			info.score, info.completedDepth, info.nodes, SearchInfo::now() - info.startTime);
+		for (int i = 0; i < info.pvLength; i++) {
+			position.moveToString(info.pv[i], moveString);
+			length += snprintf(reply + length, sizeof(reply) - length, "%s\"%s\"", i > 0 ? ", " : "", moveString);
+		}
+		snprintf(reply + length, sizeof(reply) - length, "]%s}\n", job->cancelled ? ", \"cancelled\": true" : "");
+		job->connection->send(reply);
+	}
+}
+
+// Stops the searches and drops the queued jobs of a connection, or of every connection if null
+void AnalysisServer::cancelAll(const Connection* connection) {
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto& active : running) {
+		if (connection == nullptr || active->connection.get() == connection) {
+			active->info.stop = true;
+		}
+	}
+	queue.erase(std::remove_if(queue.begin(), queue.end(), [connection](const std::shared_ptr<Job>& job) {
+		return connection == nullptr || job->connection.get() == connection;
+	}), queue.end());
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Board.h"
+#include "TranspositionTable.h"
+
+
+// Line-delimited JSON analysis service on a Unix domain socket or localhost TCP port.
+// Requests, one object per line:
+//	{"id": <any>, "fen": "<fen>", "movetime": <ms>, "nodes": <n>, "depth": <n>}
+//	{"cancel": <id>}
+//	{"shutdown": true}
+// Every analysis request gets exactly one reply with the same id:
+//	{"id": <id>, "bestmove": "e2e4", "score": 0.25, "depth": 9, "nodes": 123456, "time": 100, "pv": ["e2e4", ...]}
+//	{"id": <id>, "error": "<message>"}
+// Cancelled searches reply with their best move so far and "cancelled": true.
+class AnalysisServer {
+public:
+	AnalysisServer(TranspositionTable* table, int workers, size_t queueCapacity);
+	~AnalysisServer();
+
+	// Binds "unix:<path>" or "tcp:<port>" (127.0.0.1 only); returns false with a message printed on failure
+	bool listen(const std::string& address);
+
+	// Accepts connections and serves requests until a shutdown request arrives
+	void run();
+
+private:
+	struct Connection;
+	struct Job;
+
+	TranspositionTable* table;
+	int workers;
+	size_t queueCapacity;
+	int listener;
+	std::string socketPath; // unlinked on exit for Unix sockets
+	std::atomic<bool> shuttingDown;
+
+	std::mutex mutex; // guards everything below
+	std::condition_variable jobReady;
+	std::condition_variable connectionClosed;
+	std::deque<std::shared_ptr<Job>> queue;
+	std::vector<std::shared_ptr<Job>> running;
+	std::vector<std::shared_ptr<Connection>> connections; // open clients, each served by a detached reader thread
+
+	// Reads requests from one client until it disconnects
+	void serveConnection(std::shared_ptr<Connection> connection);
+
+	// Handles one request line
+	void handleRequest(const std::shared_ptr<Connection>& connection, const std::string& line);
+
+	// Searches queued jobs until shutdown
+	void workerLoop();
+
+	// Stops the searches and drops the queued jobs of a connection, or of every connection if null
+	void cancelAll(const Connection* connection);
+};
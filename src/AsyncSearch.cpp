@@ -0,0 +1,120 @@
+#include "AsyncSearch.h"
+#include <algorithm>
+
+
+SearchLimits::SearchLimits() {
+	time[0] = time[1] = -1;
+	increment[0] = increment[1] = 0;
+	movesToGo = 0;
+	moveTime = -1;
+	depth = 64;
+	nodes = 0;
+	multiPV = 1;
+	infinite = false;
+	ponder = false;
+}
+
+// Milliseconds to spend on a move for the given side, -1 for no time limit
+long long SearchLimits::budget(unsigned char colorToMove) const {
+	if (infinite) {
+		return -1;
+	}
+	if (moveTime >= 0) {
+		return moveTime;
+	}
+	int side = colorToMove == Piece::BLACK;
+	if (time[side] < 0) {
+		return -1;
+	}
+
+	long long movesLeft = movesToGo > 0 ? movesToGo : 30;
+	long long allotted = time[side] / movesLeft + increment[side] * 3 / 4;
+	return std::max(1LL, std::min(allotted, time[side] - 50));
+}
+
+
+AsyncSearch::AsyncSearch(TranspositionTable* table) {
+	this->table = table;
+	info.table = table;
+	info.printInfo = true;
+	stopRequested = false;
+	budget = -1;
+}
+
+AsyncSearch::~AsyncSearch() {
+	stop();
+	wait();
+}
+
+// Starts searching a copy of position; prints "bestmove <move> [ponder <move>]" when done
+void AsyncSearch::start(const Board& position, const SearchLimits& limits) {
+	stop();
+	wait();
+
+	info.reset();
+	info.nodeLimit = limits.nodes;
+	info.pondering = limits.ponder;
+	budget = limits.budget(position.colorToMove);
+	if (!limits.ponder && budget >= 0) {
+		info.deadline = info.startTime + budget;
+	}
+	stopRequested = false;
+	table->newSearch();
+
+	thread = std::thread(&AsyncSearch::run, this, position, limits);
+}
+
+// The expected move was played: the ponder search becomes a normal search with the budget starting now
+void AsyncSearch::ponderhit() {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!info.pondering) {
+		return;
+	}
+	if (budget >= 0) {
+		info.deadline = SearchInfo::now() + budget;
+	}
+	info.pondering = false;
+	released.notify_one();
+}
+
+// Stops the search as soon as possible; the best move found so far is still printed
+void AsyncSearch::stop() {
+	std::lock_guard<std::mutex> lock(mutex);
+	stopRequested = true;
+	info.stop = true;
+	released.notify_one();
+}
+
+// Waits for the search thread to finish
+void AsyncSearch::wait() {
+	if (thread.joinable()) {
+		thread.join();
+	}
+}
+
+void AsyncSearch::run(Board position, SearchLimits limits) {
+	position.searchInfo = &info;
+	PVLine lines[SearchInfo::MAX_PV];
+	position.searchMultiPV(lines, std::max(1, limits.multiPV), std::max(1, limits.depth));
+
+	// a finished ponder search holds its move until ponderhit or stop
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		released.wait(lock, [this] { return !info.pondering || stopRequested; });
+	}
+
+	if (info.pvLength == 0) {
+		printf("bestmove 0000\n");
+		fflush(stdout);
+		return;
+	}
+	char moveString[6];
+	position.moveToString(info.pv[0], moveString);
+	printf("bestmove %s", moveString);
+	if (info.pvLength > 1) {
+		position.moveToString(info.pv[1], moveString);
+		printf(" ponder %s", moveString);
+	}
+	printf("\n");
+	fflush(stdout);
+}
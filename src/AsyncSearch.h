@@ -0,0 +1,56 @@
+#pragma once
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "Board.h"
+#include "TranspositionTable.h"
+
+
+// Limits parsed from a go command
+struct SearchLimits {
+	long long time[2]; // milliseconds left for white and black, -1 if unknown
+	long long increment[2];
+	int movesToGo; // 0 if unknown
+	long long moveTime; // -1 if not fixed
+	int depth;
+	unsigned long long nodes; // 0: no limit
+	int multiPV; // number of best lines to report
+	bool infinite;
+	bool ponder;
+
+	SearchLimits();
+
+	// Milliseconds to spend on a move for the given side, -1 for no time limit
+	long long budget(unsigned char colorToMove) const;
+};
+
+
+// Iterative deepening on a background thread, controlled by stop and ponderhit
+class AsyncSearch {
+public:
+	AsyncSearch(TranspositionTable* table);
+	~AsyncSearch();
+
+	// Starts searching a copy of position; prints "bestmove <move> [ponder <move>]" when done
+	void start(const Board& position, const SearchLimits& limits);
+
+	// The expected move was played: the ponder search becomes a normal search with the budget starting now
+	void ponderhit();
+
+	// Stops the search as soon as possible; the best move found so far is still printed
+	void stop();
+
+	// Waits for the search thread to finish
+	void wait();
+
+private:
+	TranspositionTable* table;
+	SearchInfo info;
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable released;
+	bool stopRequested;
+	long long budget;
+
+	void run(Board position, SearchLimits limits);
+};
@@ -0,0 +1,77 @@
+#pragma once
+#include <array>
+
+
+// Builds the attack tables at compile time by walking every direction from the middle of the difference range
+struct AttackTables {
+	// Kinds of attackers in attackTable
+	static const unsigned char WHITE_PAWN = 1;
+	static const unsigned char BLACK_PAWN = 2;
+	static const unsigned char KNIGHT = 4;
+	static const unsigned char BISHOP = 8;
+	static const unsigned char ROOK = 16;
+	static const unsigned char KING = 32;
+
+	static constexpr signed char directions[8] = { 16, -16, 1, -1, 17, -17, 15, -15 }; // rook steps first
+	static constexpr signed char knightDirections[8] = { 31, 33, 18, -14, -31, -33, -18, 14 };
+
+	static constexpr std::array<unsigned char, 240> attackTable() {
+		std::array<unsigned char, 240> table = {};
+		for (int d = 0; d < 8; d++) {
+			unsigned char kind = d < 4 ? ROOK : BISHOP;
+			for (int distance = 1; distance < 8; distance++) {
+				table[directions[d] * distance + 119] |= kind;
+			}
+			table[directions[d] + 119] |= KING;
+			table[knightDirections[d] + 119] |= KNIGHT;
+		}
+
+		// a white pawn attacks the squares 15 and 17 above it, so from - to is -15 or -17
+		table[-15 + 119] |= WHITE_PAWN;
+		table[-17 + 119] |= WHITE_PAWN;
+		table[15 + 119] |= BLACK_PAWN;
+		table[17 + 119] |= BLACK_PAWN;
+		return table;
+	}
+
+	static constexpr std::array<signed char, 240> deltaTable() {
+		std::array<signed char, 240> table = {};
+		for (int d = 0; d < 8; d++) {
+			for (int distance = 1; distance < 8; distance++) {
+				table[directions[d] * distance + 119] = directions[d];
+			}
+		}
+		return table;
+	}
+
+	// On-board squares one of the steps away from each square, ended by -2
+	static constexpr std::array<std::array<unsigned char, 9>, 128> targets(const signed char* steps) {
+		std::array<std::array<unsigned char, 9>, 128> table = {};
+		for (int square = 0; square < 128; square++) {
+			int count = 0;
+			for (int d = 0; d < 8; d++) {
+				unsigned char target = square + steps[d];
+				if ((square & 0x88) == 0 && (target & 0x88) == 0) {
+					table[square][count++] = target;
+				}
+			}
+			table[square][count] = -2;
+		}
+		return table;
+	}
+};
+
+// 0x88 attack lookup tables; a difference of two squares indexes them as from - to + 119
+struct Attacks : AttackTables {
+	static constexpr std::array<unsigned char, 240> attackTable = AttackTables::attackTable(); // [from - to + 119]: kinds of piece on from that attack to if the path between is empty
+	static constexpr std::array<signed char, 240> deltaTable = AttackTables::deltaTable(); // [from - to + 119]: step from to toward from along a line, 0 if there is none
+	static constexpr std::array<std::array<unsigned char, 9>, 128> knightTargets = targets(knightDirections); // [0x88 square]: squares a knight reaches, ended by -2
+	static constexpr std::array<std::array<unsigned char, 9>, 128> kingTargets = targets(directions); // [0x88 square]: squares a king reaches, ended by -2
+
+	// [piece code]: its kind in attackTable; queens are bishops and rooks at once
+	static constexpr unsigned char pieceKinds[24] = {
+		0, 0, 0, 0, 0, 0, 0, 0,
+		0, BLACK_PAWN, KNIGHT, BISHOP, ROOK, BISHOP | ROOK, KING, 0,
+		0, WHITE_PAWN, KNIGHT, BISHOP, ROOK, BISHOP | ROOK, KING, 0
+	};
+};
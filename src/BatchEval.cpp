@@ -0,0 +1,176 @@
+#include <algorithm>
+#include "BatchEval.h"
+#include "Material.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BATCH_EVAL_AVX2
+#endif
+
+
+PositionBatch::PositionBatch(size_t capacity) {
+	this->capacity = (capacity + 7) / 8 * 8;
+	pieces.resize(MAX_PIECES * this->capacity);
+	kings[0].resize(this->capacity);
+	kings[1].resize(this->capacity);
+	imbalance.resize(this->capacity);
+	phase.resize(this->capacity);
+	scale[0].resize(this->capacity);
+	scale[1].resize(this->capacity);
+	clear();
+}
+
+// Appends a position; returns false if the batch is full
+bool PositionBatch::add(const Board& position) {
+	if (size == capacity) {
+		return false;
+	}
+	int slot = 0;
+	for (int i = 0; i < 128; i++) {
+		unsigned char piece = position.board[i];
+		if (piece == Piece::NONE || (piece & 0x07) == Piece::KING || slot == MAX_PIECES) {
+			continue;
+		}
+		pieces[slot++ * capacity + size] = piece * 64 + i / 16 * 8 + i % 16;
+	}
+	columns = std::max(columns, slot);
+	kings[0][size] = (7 - position.kingPosition[0] / 16) * 8 + position.kingPosition[0] % 16;
+	kings[1][size] = position.kingPosition[1] / 16 * 8 + position.kingPosition[1] % 16;
+
+	const MaterialEntry* material = Material::probe(position.materialKey);
+	int factors[2];
+	Material::scaleFactors(position, material, factors);
+	imbalance[size] = material->imbalance;
+	phase[size] = material->phase;
+	scale[0][size] = factors[0];
+	scale[1][size] = factors[1];
+	if (material->evaluator != nullptr) {
+		known.emplace_back(size, material->evaluator(position, material->strongSide) / 100.0);
+	}
+	size++;
+	return true;
+}
+
+// Empties the batch, keeping its storage
+void PositionBatch::clear() {
+	std::fill(pieces.begin(), pieces.end(), EMPTY);
+	std::fill(kings[0].begin(), kings[0].end(), 0);
+	std::fill(kings[1].begin(), kings[1].end(), 0);
+	std::fill(imbalance.begin(), imbalance.end(), 0);
+	std::fill(phase.begin(), phase.end(), 0);
+	std::fill(scale[0].begin(), scale[0].end(), 0);
+	std::fill(scale[1].begin(), scale[1].end(), 0);
+	known.clear();
+	size = 0;
+	columns = 0;
+}
+
+
+// Writes the score of every position in the batch, using AVX2 when the processor has it
+void BatchEval::evaluate(const PositionBatch& batch, double* scores) {
+	static const bool avx2 = hasAvx2();
+	if (avx2) {
+		evaluateAvx2(batch, scores);
+	}
+	else {
+		evaluateScalar(batch, scores);
+	}
+}
+
+// Overwrites the scores of the positions in known endings
+static void scoreKnown(const PositionBatch& batch, double* scores) {
+	for (const std::pair<size_t, double>& known : batch.known) {
+		scores[known.first] = known.second;
+	}
+}
+
+// Portable implementation; the king terms repeat the int += double steps of evaluatePosition exactly
+void BatchEval::evaluateScalar(const PositionBatch& batch, double* scores) {
+	for (size_t p = 0; p < batch.size; p++) {
+		int evaluation = batch.imbalance[p];
+		for (int slot = 0; slot < batch.columns; slot++) {
+			evaluation += signedValues[batch.pieces[slot * batch.capacity + p]];
+		}
+
+		int white = batch.kings[0][p], black = batch.kings[1][p];
+		evaluation += kingMiddle[white] + (kingEnd[white] - kingMiddle[white]) * batch.phase[p];
+		evaluation -= kingMiddle[black] + (kingEnd[black] - kingMiddle[black]) * batch.phase[p];
+		evaluation = evaluation * batch.scale[evaluation < 0][p] / Material::SCALE_NORMAL;
+		scores[p] = evaluation / 100.0;
+	}
+	scoreKnown(batch, scores);
+}
+
+#ifdef BATCH_EVAL_AVX2
+// Finishes four positions in double precision with the same operations, in the same order, as the scalar code.
+// FMA stays disabled so that the multiply and add are rounded separately.
+__attribute__((target("avx2")))
+static inline void finishAvx2(__m128i evaluation, __m256d phase, __m128i whiteMiddle, __m128i whiteEnd,
+	__m128i blackMiddle, __m128i blackEnd, __m128i whiteScale, __m128i blackScale, double* scores) {
+	__m256d white = _mm256_add_pd(_mm256_cvtepi32_pd(whiteMiddle), _mm256_mul_pd(_mm256_cvtepi32_pd(_mm_sub_epi32(whiteEnd, whiteMiddle)), phase));
+	__m256d black = _mm256_add_pd(_mm256_cvtepi32_pd(blackMiddle), _mm256_mul_pd(_mm256_cvtepi32_pd(_mm_sub_epi32(blackEnd, blackMiddle)), phase));
+	evaluation = _mm256_cvttpd_epi32(_mm256_add_pd(_mm256_cvtepi32_pd(evaluation), white));
+	evaluation = _mm256_cvttpd_epi32(_mm256_sub_pd(_mm256_cvtepi32_pd(evaluation), black));
+
+	// evaluation * scale / SCALE_NORMAL rounding toward zero like integer division: the division is a shift, and negative
+	// products are biased by SCALE_NORMAL - 1 first
+	static_assert(Material::SCALE_NORMAL > 0 && (Material::SCALE_NORMAL & (Material::SCALE_NORMAL - 1)) == 0,
+		"the AVX2 scaling divides by SCALE_NORMAL with a shift");
+	__m128i scale = _mm_blendv_epi8(whiteScale, blackScale, _mm_cmplt_epi32(evaluation, _mm_setzero_si128()));
+	__m128i product = _mm_mullo_epi32(evaluation, scale);
+	product = _mm_add_epi32(product, _mm_and_si128(_mm_srai_epi32(product, 31), _mm_set1_epi32(Material::SCALE_NORMAL - 1)));
+	evaluation = _mm_srai_epi32(product, __builtin_ctz(Material::SCALE_NORMAL));
+	_mm256_storeu_pd(scores, _mm256_div_pd(_mm256_cvtepi32_pd(evaluation), _mm256_set1_pd(100.0)));
+}
+
+// Eight positions per step: each slot is one contiguous load of table indices and two gathers.
+// The padding after the last position holds empty slots, so a partial last group is scored into a scratch buffer.
+__attribute__((target("avx2")))
+void BatchEval::evaluateAvx2(const PositionBatch& batch, double* scores) {
+	for (size_t p = 0; p < batch.size; p += 8) {
+		__m256i evaluation = _mm256_loadu_si256((const __m256i*)&batch.imbalance[p]);
+		for (int slot = 0; slot < batch.columns; slot++) {
+			__m256i index = _mm256_loadu_si256((const __m256i*)&batch.pieces[slot * batch.capacity + p]);
+			evaluation = _mm256_add_epi32(evaluation, _mm256_i32gather_epi32(signedValues.data(), index, 4));
+		}
+
+		__m256i white = _mm256_loadu_si256((const __m256i*)&batch.kings[0][p]);
+		__m256i black = _mm256_loadu_si256((const __m256i*)&batch.kings[1][p]);
+		__m256i whiteMiddle = _mm256_i32gather_epi32(kingMiddle.data(), white, 4);
+		__m256i whiteEnd = _mm256_i32gather_epi32(kingEnd.data(), white, 4);
+		__m256i blackMiddle = _mm256_i32gather_epi32(kingMiddle.data(), black, 4);
+		__m256i blackEnd = _mm256_i32gather_epi32(kingEnd.data(), black, 4);
+		__m256i whiteScale = _mm256_loadu_si256((const __m256i*)&batch.scale[0][p]);
+		__m256i blackScale = _mm256_loadu_si256((const __m256i*)&batch.scale[1][p]);
+		double tail[8];
+		double* out = p + 8 <= batch.size ? scores + p : tail;
+		for (int half = 0; half < 2; half++) {
+			finishAvx2(half ? _mm256_extracti128_si256(evaluation, 1) : _mm256_castsi256_si128(evaluation),
+				_mm256_loadu_pd(&batch.phase[p + half * 4]),
+				half ? _mm256_extracti128_si256(whiteMiddle, 1) : _mm256_castsi256_si128(whiteMiddle),
+				half ? _mm256_extracti128_si256(whiteEnd, 1) : _mm256_castsi256_si128(whiteEnd),
+				half ? _mm256_extracti128_si256(blackMiddle, 1) : _mm256_castsi256_si128(blackMiddle),
+				half ? _mm256_extracti128_si256(blackEnd, 1) : _mm256_castsi256_si128(blackEnd),
+				half ? _mm256_extracti128_si256(whiteScale, 1) : _mm256_castsi256_si128(whiteScale),
+				half ? _mm256_extracti128_si256(blackScale, 1) : _mm256_castsi256_si128(blackScale),
+				out + half * 4);
+		}
+		if (out == tail) {
+			std::copy(tail, tail + batch.size - p, scores + p);
+		}
+	}
+	scoreKnown(batch, scores);
+}
+#else
+void BatchEval::evaluateAvx2(const PositionBatch& batch, double* scores) {
+	evaluateScalar(batch, scores);
+}
+#endif
+
+// Checks if this build and processor can run evaluateAvx2
+bool BatchEval::hasAvx2() {
+#ifdef BATCH_EVAL_AVX2
+	return __builtin_cpu_supports("avx2");
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <array>
+#include <utility>
+#include <vector>
+#include "Board.h"
+
+
+// Positions stored as structure-of-arrays for batch evaluation: column s holds the s-th non-king piece of every
+// position as an index into the evaluation tables, so one load fetches that piece for a run of consecutive positions
+struct PositionBatch {
+	static const int MAX_PIECES = 30; // non-king pieces on a legal board
+	static const int EMPTY = 0; // table index of an unused slot; its entries are zero
+
+	size_t capacity; // a multiple of 8 so vector loads never run past the end
+	size_t size;
+	int columns; // most non-king pieces of any position in the batch
+	std::vector<int> pieces; // [slot * capacity + position]: piece code * 64 + square
+	std::vector<int> kings[2]; // [color][position]: king square, flipped for white like the piece-square tables
+	std::vector<int> imbalance; // [position]: from the material table, in centipawns
+	std::vector<double> phase; // [position]: from the material table
+	std::vector<int> scale[2]; // [color][position]: scale factors of the position
+	std::vector<std::pair<size_t, double>> known; // positions in known endings, scored when they are added
+
+	PositionBatch(size_t capacity);
+
+	// Appends a position; returns false if the batch is full
+	bool add(const Board& position);
+
+	// Empties the batch, keeping its storage
+	void clear();
+};
+
+
+// Folds piece values and piece-square tables into one entry per piece code and square at compile time
+struct BatchEvalTables {
+	static constexpr std::array<int, 24 * 64> signedValues() {
+		const signed char* tables[6] = {
+			PieceSquareTables::pawnTable, PieceSquareTables::knightTable, PieceSquareTables::bishopTable,
+			PieceSquareTables::rookTable, PieceSquareTables::queenTable, nullptr
+		};
+		std::array<int, 24 * 64> values = {};
+		for (int type = Piece::PAWN; type < Piece::KING; type++) {
+			for (int square = 0; square < 64; square++) {
+				int rank = square / 8, file = square % 8;
+				values[(Piece::WHITE | type) * 64 + square] = PieceSquareTables::pieceValues[type] + tables[type - 1][(7 - rank) * 8 + file];
+				values[(Piece::BLACK | type) * 64 + square] = -(PieceSquareTables::pieceValues[type] + tables[type - 1][rank * 8 + file]);
+			}
+		}
+		return values;
+	}
+
+	// Widens a king table so it can be gathered
+	static constexpr std::array<int, 64> widen(const signed char* table) {
+		std::array<int, 64> values = {};
+		for (int square = 0; square < 64; square++) {
+			values[square] = table[square];
+		}
+		return values;
+	}
+};
+
+// Board::evaluatePosition over whole batches; scores are bit-identical to it with simple_search off
+struct BatchEval {
+	static constexpr std::array<int, 24 * 64> signedValues = BatchEvalTables::signedValues(); // [piece code * 64 + square]: value plus piece-square bonus, negative for black
+	static constexpr std::array<int, 64> kingMiddle = BatchEvalTables::widen(PieceSquareTables::kingMiddleTable);
+	static constexpr std::array<int, 64> kingEnd = BatchEvalTables::widen(PieceSquareTables::kingEndTable);
+
+	// Writes the score of every position in the batch, using AVX2 when the processor has it
+	static void evaluate(const PositionBatch& batch, double* scores);
+
+	// Portable implementation
+	static void evaluateScalar(const PositionBatch& batch, double* scores);
+
+	// AVX2 gather implementation; only call it when hasAvx2() is true
+	static void evaluateAvx2(const PositionBatch& batch, double* scores);
+
+	// Checks if this build and processor can run evaluateAvx2
+	static bool hasAvx2();
+};
@@ -1,4 +1,10 @@
 #include "Board.h"
+#include <cctype>
+#include "Attacks.h"
+#include "Material.h"
+#include "Profiler.h"
+#include "Trace.h"
+#include "TranspositionTable.h"
 
 
 // Default constructor (clears board)
@@ -40,70 +46,305 @@ unsigned char Board::stringToIndex(const char* squareString) {
 	}
 }
 
-// Generates pseudo-legal moves
-MoveList Board::GenerateMoves() {
+// Recomputes the hash of the position from scratch
+unsigned long long Board::computeHash() {
+	unsigned long long key = Zobrist::castlingKeys[whiteCastle | blackCastle << 2];
+	for (int i = 0; i < 128; i++) {
+		if (isSquareValid(i)) {
+			key ^= Zobrist::pieceKeys[board[i]][i];
+		}
+	}
+	if (isSquareValid(enPassant)) {
+		key ^= Zobrist::enPassantKeys[enPassant % 16];
+	}
+	if (colorToMove == Piece::BLACK) {
+		key ^= Zobrist::blackToMoveKey;
+	}
+	return key;
+}
+
+// Recomputes the material key of the position from scratch
+unsigned long long Board::computeMaterialKey() {
+	unsigned long long key = 0;
+	for (int i = 0; i < 128; i++) {
+		if (isSquareValid(i)) {
+			key += Material::pieceKeys[board[i]];
+		}
+	}
+	return key;
+}
+
+// Places piece (or Piece::NONE) on a square, keeping the hash and piece lists up to date
+void Board::setSquare(unsigned char index, unsigned char piece) {
+	unsigned char previous = board[index];
+	hash ^= Zobrist::pieceKeys[previous][index] ^ Zobrist::pieceKeys[piece][index];
+	materialKey += Material::pieceKeys[piece] - Material::pieceKeys[previous];
+#ifdef ATTACK_MAPS
+	if (previous != Piece::NONE) {
+		addAttacks(index, previous, -1);
+	}
+	if ((previous == Piece::NONE) != (piece == Piece::NONE)) {
+		updateRaysThrough(index, piece == Piece::NONE ? 1 : -1);
+	}
+	board[index] = piece;
+	if (piece != Piece::NONE) {
+		addAttacks(index, piece, 1);
+	}
+#else
+	board[index] = piece;
+#endif
+
+	if (previous != Piece::NONE) {
+		unsigned char* locations = pieceLocations[(previous & Piece::BLACK) != 0];
+		for (int i = 0; i < 16; i++) {
+			if (locations[i] == index) {
+				locations[i] = -2;
+				break;
+			}
+		}
+	}
+	if (piece != Piece::NONE) {
+		unsigned char* locations = pieceLocations[(piece & Piece::BLACK) != 0];
+		for (int i = 0; i < 16; i++) {
+			if (!isSquareValid(locations[i])) {
+				locations[i] = index;
+				break;
+			}
+		}
+	}
+}
+
+// Moves the piece on from to the empty or enemy-occupied square to
+void Board::movePiece(unsigned char from, unsigned char to) {
+	if (board[to] != Piece::NONE) {
+		setSquare(to, Piece::NONE);
+	}
+	unsigned char piece = board[from];
+	hash ^= Zobrist::pieceKeys[piece][from] ^ Zobrist::pieceKeys[piece][to];
+#ifdef ATTACK_MAPS
+	// lift the piece, open the rays through from, close the ones through to and put it down
+	addAttacks(from, piece, -1);
+	board[from] = Piece::NONE;
+	updateRaysThrough(from, 1);
+	updateRaysThrough(to, -1);
+	board[to] = piece;
+	addAttacks(to, piece, 1);
+#else
+	board[to] = piece;
+	board[from] = Piece::NONE;
+#endif
+
+	unsigned char* locations = pieceLocations[(piece & Piece::BLACK) != 0];
+	for (int i = 0; i < 16; i++) {
+		if (locations[i] == from) {
+			locations[i] = to;
+			break;
+		}
+	}
+}
+
+#ifdef ATTACK_MAPS
+// Index of a 0x88 square in the attack maps
+static inline int mapIndex(unsigned char square) {
+	return (square + (square & 7)) >> 1;
+}
+
+// Number of pieces of color attacking squarePos, read from the attack maps
+int Board::attackers(unsigned char squarePos, unsigned char color) {
+	return attackCounts[color == Piece::BLACK][mapIndex(squarePos)];
+}
+
+// Recomputes the attack maps from scratch
+void Board::computeAttackCounts() {
+	std::memset(attackCounts, 0, sizeof(attackCounts));
+	for (int i = 0; i < 128; i++) {
+		if (isSquareValid(i) && board[i] != Piece::NONE) {
+			addAttacks(i, board[i], 1);
+		}
+	}
+}
+
+// Adds delta to the count of every square the piece on index attacks
+void Board::addAttacks(unsigned char index, unsigned char piece, int delta) {
+	unsigned char* counts = attackCounts[(piece & Piece::BLACK) != 0];
+	const unsigned char* target;
+	switch (piece & 0x07) {
+		case Piece::PAWN: {
+			unsigned char forward = piece & Piece::BLACK ? index - 16 : index + 16;
+			if (isSquareValid(forward - 1)) {
+				counts[mapIndex(forward - 1)] += delta;
+			}
+			if (isSquareValid(forward + 1)) {
+				counts[mapIndex(forward + 1)] += delta;
+			}
+			return;
+		}
+
+		case Piece::KNIGHT:
+		case Piece::KING:
+			target = (piece & 0x07) == Piece::KNIGHT ? Attacks::knightTargets[index].data() : Attacks::kingTargets[index].data();
+			for (; *target != (unsigned char)-2; target++) {
+				counts[mapIndex(*target)] += delta;
+			}
+			return;
+	}
+
+	// sliders attack along each of their rays up to and including the first piece
+	for (int d = 0; d < 8; d++) {
+		if (!(Attacks::pieceKinds[piece] & (d < 4 ? Attacks::ROOK : Attacks::BISHOP))) {
+			continue;
+		}
+		for (unsigned char pos = index + Attacks::directions[d]; isSquareValid(pos); pos += Attacks::directions[d]) {
+			counts[mapIndex(pos)] += delta;
+			if (board[pos] != Piece::NONE) {
+				break;
+			}
+		}
+	}
+}
+
+// Adds delta to the squares behind index on the rays of the sliders that reach it: 1 when index empties, -1 when it fills
+void Board::updateRaysThrough(unsigned char index, int delta) {
+	// a slider reaching index attacks it
+	if (attackCounts[0][mapIndex(index)] == 0 && attackCounts[1][mapIndex(index)] == 0) {
+		return;
+	}
+
+	// directions come in opposite pairs; the nearest piece on one side sees through index up to the nearest piece on the other
+	for (int d = 0; d < 8; d += 2) {
+		unsigned char kind = d < 4 ? Attacks::ROOK : Attacks::BISHOP;
+		signed char steps[2] = { Attacks::directions[d], Attacks::directions[d + 1] };
+		unsigned char ends[2];
+		for (int side = 0; side < 2; side++) {
+			unsigned char pos = index + steps[side];
+			while (isSquareValid(pos) && board[pos] == Piece::NONE) {
+				pos += steps[side];
+			}
+			ends[side] = pos;
+		}
+
+		for (int side = 0; side < 2; side++) {
+			unsigned char slider = isSquareValid(ends[side]) ? board[ends[side]] : Piece::NONE;
+			if (!(Attacks::pieceKinds[slider] & kind)) {
+				continue;
+			}
+			unsigned char* counts = attackCounts[(slider & Piece::BLACK) != 0];
+			unsigned char end = ends[1 - side];
+			for (unsigned char pos = index + steps[1 - side]; pos != end; pos += steps[1 - side]) {
+				counts[mapIndex(pos)] += delta;
+			}
+			if (isSquareValid(end)) {
+				counts[mapIndex(end)] += delta;
+			}
+		}
+	}
+}
+#endif
+
+// Compile-time facts about one side, so that move generation and makeMove never branch on colorToMove
+template <unsigned char color>
+struct Side {
+	static constexpr unsigned char enemy = 24 - color;
+	static constexpr int index = color == Piece::BLACK;
+	static constexpr signed char forward = color == Piece::WHITE ? 16 : -16;
+	static constexpr int startRank = color == Piece::WHITE ? 1 : 6;
+	static constexpr int promotionRank = color == Piece::WHITE ? 7 : 0;
+	static constexpr unsigned char kingStart = color == Piece::WHITE ? 4 : 116;
+
+	// Castling: [0] kingside, [1] queenside
+	static constexpr unsigned char castleRights[2] = { 1, 2 };
+	static constexpr unsigned char kingTo[2] = { kingStart + 2, kingStart - 2 };
+	static constexpr unsigned char rookFrom[2] = { kingStart + 3, kingStart - 4 };
+	static constexpr unsigned char rookTo[2] = { kingStart + 1, kingStart - 1 };
+};
+
+static constexpr signed char bishopDirections[4] = { 17, -17, 15, -15 };
+static constexpr signed char rookDirections[4] = { 16, -16, 1, -1 };
+static constexpr signed char queenDirections[8] = { 16, -16, 1, -1, 17, -17, 15, -15 };
+static constexpr unsigned char promotionTypes[4] = { 4, 5, 6, 7 }; // queen, knight, bishop, rook
+static constexpr unsigned char promotionPieces[4] = { Piece::QUEEN, Piece::KNIGHT, Piece::BISHOP, Piece::ROOK };
+
+// Adds the moves of a sliding piece of color along the given directions
+template <unsigned char color, int count>
+static inline void addSlides(MoveList& moves, const unsigned char* board, unsigned char startPos, const signed char (&directions)[count]) {
+	for (int dIndex = 0; dIndex < count; dIndex++) {
+		unsigned char endPos = startPos;
+		while (true) {
+			endPos += directions[dIndex];
+			if (endPos & 0x88) {
+				break;
+			}
+			unsigned char endSquare = board[endPos];
+			if (endSquare == Piece::NONE) {
+				moves.push_back(startPos, endPos, 0);
+				continue;
+			}
+			if ((endSquare & 0x18) != color) {
+				moves.push_back(startPos, endPos, 0);
+			}
+			break;
+		}
+	}
+}
+
+// Adds the moves of a knight or king of color from a target list ended by -2
+template <unsigned char color>
+static inline void addSteps(MoveList& moves, const unsigned char* board, unsigned char startPos, const unsigned char* target) {
+	for (; *target != (unsigned char)-2; target++) {
+		unsigned char endSquare = board[*target];
+		if (endSquare == Piece::NONE || (endSquare & 0x18) != color) {
+			moves.push_back(startPos, *target, 0);
+		}
+	}
+}
+
+// Adds a pawn move, expanded into the four promotions on the last rank
+template <unsigned char color>
+static inline void addPawnMove(MoveList& moves, unsigned char startPos, unsigned char endPos) {
+	if (endPos / 16 == Side<color>::promotionRank) {
+		for (unsigned char type : promotionTypes) {
+			moves.push_back(startPos, endPos, type);
+		}
+	}
+	else {
+		moves.push_back(startPos, endPos, 0);
+	}
+}
+
+// Generates pseudo-legal moves for color, which must be the side to move
+template <unsigned char color>
+MoveList Board::generateMoves() {
+	PROFILE_SCOPE(Profiler::GENERATE_MOVES);
+	typedef Side<color> S;
 	MoveList moves;
 
-	bool colorIndex = colorToMove == Piece::BLACK;
 	for (int i = 0; i < 128; i++) {
 		if (!isSquareValid(i)) {
 			continue;
 		}
 		unsigned char square = board[i];
-		if (square == Piece::NONE || (square & 0x18) != colorToMove) {
+		if (square == Piece::NONE || (square & 0x18) != color) {
 			continue;
 		}
 
 		unsigned char startPos = i, endPos, endSquare;
-
-		// Direction offset indices
-		char direction[] = {16, -16, 1, -1, 17, -17, 15, -15};
-		char knightDirection[] = {31, 33, 18, -14, -31, -33, -18, 14}; // clockwise starting top left
-		char pawnForward = colorToMove * 4 - 48;
-		char pawnDirection[] = {pawnForward, char(2 * pawnForward), char(pawnForward - 1), char(pawnForward + 1)};
-
-		// Determine piece type and generate moves
 		switch (square & 0x07) {
 			case Piece::PAWN:
-				// Forward one
-				endPos = startPos + pawnDirection[0];
-				endSquare = board[endPos];
-				if (endSquare == Piece::NONE) {
-					if (int(endPos / 16) == 0 || int(endPos / 16) == 7) {
-						moves.push_back(startPos, endPos, 4);
-						moves.push_back(startPos, endPos, 5);
-						moves.push_back(startPos, endPos, 6);
-						moves.push_back(startPos, endPos, 7);
-					}
-					else {
-						moves.push_back(startPos, endPos, 0);
-					}
-
-					// Forward two
-					if (int(startPos / 16) == 1 || int(startPos / 16) == 6) {
-						endPos = startPos + pawnDirection[1];
-						if (isSquareValid(endPos)) {
-							endSquare = board[endPos];
-							if (endSquare == Piece::NONE) {
-								moves.push_back(startPos, endPos, 1);
-							}
-						}
+				// Forward one, and two from the starting rank
+				endPos = startPos + S::forward;
+				if (board[endPos] == Piece::NONE) {
+					addPawnMove<color>(moves, startPos, endPos);
+					if (startPos / 16 == S::startRank && board[endPos + S::forward] == Piece::NONE) {
+						moves.push_back(startPos, endPos + S::forward, 1);
 					}
 				}
 
-				for (int dIndex = 2; dIndex < 4; dIndex++) {
-					endPos = startPos + pawnDirection[dIndex];
+				// Captures
+				for (signed char side : { -1, 1 }) {
+					endPos = startPos + S::forward + side;
 					endSquare = board[endPos];
-					if (endSquare != Piece::NONE && (endSquare & 0x18) != colorToMove) {
-						if (int(endPos / 16) == 0 || int(endPos / 16) == 7) {
-							moves.push_back(startPos, endPos, 4);
-							moves.push_back(startPos, endPos, 5);
-							moves.push_back(startPos, endPos, 6);
-							moves.push_back(startPos, endPos, 7);
-						}
-						else {
-							moves.push_back(startPos, endPos, 0);
-						}
+					if (endSquare != Piece::NONE && (endSquare & 0x18) != color) {
+						addPawnMove<color>(moves, startPos, endPos);
 					}
 					if (endPos == enPassant) {
 						moves.push_back(startPos, endPos, 2);
@@ -112,124 +353,35 @@ MoveList Board::GenerateMoves() {
 				break;
 
 			case Piece::KNIGHT:
-				for (int dIndex = 0; dIndex < 8; dIndex++) {
-					endPos = startPos + knightDirection[dIndex];
-					if (!isSquareValid(endPos)) {
-						continue;
-					}
-					endSquare = board[endPos];
-					if (endSquare == Piece::NONE || (endSquare & 0x18) != colorToMove) {
-						moves.push_back(startPos, endPos, 0);
-					}
-				}
+				addSteps<color>(moves, board, startPos, Attacks::knightTargets[startPos].data());
 				break;
 
 			case Piece::BISHOP:
-				for (int dIndex = 4; dIndex < 8; dIndex++) {
-					endPos = startPos;
-					while (true) {
-						endPos += direction[dIndex];
-						if (!isSquareValid(endPos)) {
-							break;
-						}
-						endSquare = board[endPos];
-						if (endSquare == Piece::NONE) {
-							moves.push_back(startPos, endPos, 0);
-							continue;
-						}
-						if ((endSquare & 0x18) != colorToMove) {
-							moves.push_back(startPos, endPos, 0);
-						}
-						break;
-					}
-				}
+				addSlides<color>(moves, board, startPos, bishopDirections);
 				break;
 
 			case Piece::ROOK:
-				for (int dIndex = 0; dIndex < 4; dIndex++) {
-					endPos = startPos;
-					while (true) {
-						endPos += direction[dIndex];
-						if (!isSquareValid(endPos)) {
-							break;
-						}
-						endSquare = board[endPos];
-						if (endSquare == Piece::NONE) {
-							moves.push_back(startPos, endPos, 0);
-							continue;
-						}
-						if ((endSquare & 0x18) != colorToMove) {
-							moves.push_back(startPos, endPos, 0);
-						}
-						break;
-					}
-				}
+				addSlides<color>(moves, board, startPos, rookDirections);
 				break;
 
 			case Piece::QUEEN:
-				for (int dIndex = 0; dIndex < 8; dIndex++) {
-					endPos = startPos;
-					while (true) {
-						endPos += direction[dIndex];
-						if (!isSquareValid(endPos)) {
-							break;
-						}
-						endSquare = board[endPos];
-						if (endSquare == Piece::NONE) {
-							moves.push_back(startPos, endPos, 0);
-							continue;
-						}
-						if ((endSquare & 0x18) != colorToMove) {
-							moves.push_back(startPos, endPos, 0);
-						}
-						break;
-					}
-				}
+				addSlides<color>(moves, board, startPos, queenDirections);
 				break;
 
 			case Piece::KING:
-				for (int dIndex = 0; dIndex < 8; dIndex++) {
-					endPos = startPos + direction[dIndex];
-					if (!isSquareValid(endPos)) {
-						continue;
-					}
-					endSquare = board[endPos];
-					if (endSquare == Piece::NONE || (endSquare & 0x18) != colorToMove) {
-						moves.push_back(startPos, endPos, 0);
-					}
-				}
+				addSteps<color>(moves, board, startPos, Attacks::kingTargets[startPos].data());
 
-				// Castling
-				if (colorToMove == Piece::WHITE) {
-					if (whiteCastle == 1 || whiteCastle == 3) {
-						if (board[5] == Piece::NONE && board[6] == Piece::NONE) {
-							if (!isInCheck(4, 24 - colorToMove) && !isInCheck(5, 24 - colorToMove)) {
-								moves.push_back(startPos, 6, 3);
-							}
-						}
-					}
-					if (whiteCastle == 2 || whiteCastle == 3) {
-						if (board[1] == Piece::NONE && board[2] == Piece::NONE && board[3] == Piece::NONE) {
-							if (!isInCheck(4, 24 - colorToMove) && !isInCheck(3, 24 - colorToMove)) {
-								moves.push_back(startPos, 2, 3);
-							}
-						}
+				// Castling: the squares between king and rook are empty and the king doesn't start in or pass through check
+				unsigned char rights = color == Piece::WHITE ? whiteCastle : blackCastle;
+				if ((rights & S::castleRights[0]) && board[S::kingStart + 1] == Piece::NONE && board[S::kingStart + 2] == Piece::NONE) {
+					if (!isAttackedBy<S::enemy>(S::kingStart) && !isAttackedBy<S::enemy>(S::kingStart + 1)) {
+						moves.push_back(startPos, S::kingTo[0], 3);
 					}
 				}
-				else {
-					if (blackCastle == 1 || blackCastle == 3) {
-						if (board[117] == Piece::NONE && board[118] == Piece::NONE) {
-							if (!isInCheck(116, 24 - colorToMove) && !isInCheck(117, 24 - colorToMove)) {
-								moves.push_back(startPos, 118, 3);
-							}
-						}
-					}
-					if (blackCastle == 2 || blackCastle == 3) {
-						if (board[113] == Piece::NONE && board[114] == Piece::NONE && board[115] == Piece::NONE) {
-							if (!isInCheck(116, 24 - colorToMove) && !isInCheck(115, 24 - colorToMove)) {
-								moves.push_back(startPos, 114, 3);
-							}
-						}
+				if ((rights & S::castleRights[1]) && board[S::kingStart - 1] == Piece::NONE && board[S::kingStart - 2] == Piece::NONE
+					&& board[S::kingStart - 3] == Piece::NONE) {
+					if (!isAttackedBy<S::enemy>(S::kingStart) && !isAttackedBy<S::enemy>(S::kingStart - 1)) {
+						moves.push_back(startPos, S::kingTo[1], 3);
 					}
 				}
 				break;
@@ -238,20 +390,37 @@ MoveList Board::GenerateMoves() {
 	return moves;
 }
 
-// Update board with move; returns true if legal
-bool Board::makeMove(Move* move) {
-	for (int i = 0; i < 2; i++) {
-		if (move->from == kingPosition[i]) {
-			kingPosition[i] = move->to;
-		}
+// Generates pseudo-legal moves
+MoveList Board::GenerateMoves() {
+	return colorToMove == Piece::WHITE ? generateMoves<Piece::WHITE>() : generateMoves<Piece::BLACK>();
+}
+
+// makeMove for color, which must be the side to move
+template <unsigned char color>
+bool Board::makeMoveAs(Move* move) {
+	PROFILE_SCOPE(Profiler::MAKE_MOVE);
+	typedef Side<color> S;
+	if (move->from == kingPosition[S::index]) {
+		kingPosition[S::index] = move->to;
 	}
 
-	bool colorIndex = colorToMove == Piece::BLACK;
-	bool capture = false;
-	if (board[move->to] != Piece::NONE) {
-		capture = true;
+	// halfmove clock restarts on pawn moves and captures
+	if (board[move->to] != Piece::NONE || (board[move->from] & 0x07) == Piece::PAWN) {
+		halfMoves = 0;
+	}
+	else if (halfMoves < 255) {
+		halfMoves++;
 	}
 
+	if (history != nullptr && historyLength < PositionHistory::CAPACITY) {
+		history->keys[historyLength++] = hash;
+	}
+
+	// remove the old castling and en passant keys; the new ones are added once the move is made
+	hash ^= Zobrist::castlingKeys[whiteCastle | blackCastle << 2];
+	if (isSquareValid(enPassant)) {
+		hash ^= Zobrist::enPassantKeys[enPassant % 16];
+	}
 	enPassant = -2;
 
 	// castling rights
@@ -262,102 +431,120 @@ bool Board::makeMove(Move* move) {
 		blackCastle = 0;
 	}
 	if (move->from == 7 || move->to == 7) {
-		if (whiteCastle % 2 == 1) {
-			whiteCastle--;
-		}
+		whiteCastle &= ~1;
 	}
 	if (move->from == 0 || move->to == 0) {
-		if (whiteCastle > 1) {
-			whiteCastle -= 2;
-		}
+		whiteCastle &= ~2;
 	}
 	if (move->from == 119 || move->to == 119) {
-		if (blackCastle % 2 == 1) {
-			blackCastle--;
-		}
+		blackCastle &= ~1;
 	}
 	if (move->from == 112 || move->to == 112) {
-		if (blackCastle > 1) {
-			blackCastle -= 2;
-		}
+		blackCastle &= ~2;
 	}
 
-
 	// Move types
-	if (move->type == 0) {
-		board[move->to] = board[move->from];
-		board[move->from] = Piece::NONE;
-	}
+	switch (move->type) {
+		case 0:
+			movePiece(move->from, move->to);
+			break;
 
-	if (move->type == 1) {
-		board[move->to] = board[move->from];
-		board[move->from] = Piece::NONE;
-		enPassant = (move->to + move->from) / 2;
-	}
+		case 1:
+			movePiece(move->from, move->to);
+			enPassant = move->from + S::forward;
+			break;
 
-	if (move->type == 2) {
-		board[move->to] = board[move->from];
-		board[move->from] = Piece::NONE;
-		board[move->to + colorToMove * -4 + 48] = Piece::NONE;
-	}
+		case 2:
+			movePiece(move->from, move->to);
+			setSquare(move->to - S::forward, Piece::NONE);
+			break;
 
-	// castling -- CLEAN UP
-	if (move->type == 3) {
-		board[move->to] = board[move->from];
-		board[move->from] = Piece::NONE;
-		board[int((move->to + move->from) / 2)] = Piece::ROOK | colorToMove;
-		if (move->to == 6) {
-			board[7] = Piece::NONE;
-			whiteCastle = 0;
-		}
-		if (move->to == 2) {
-			board[0] = Piece::NONE;
-			whiteCastle = 0;
-		}
-		if (move->to == 118) {
-			board[119] = Piece::NONE;
-			blackCastle = 0;
-		}
-		if (move->to == 114) {
-			board[112] = Piece::NONE;
-			blackCastle = 0;
-		}
-	}
+		case 3:
+			movePiece(move->from, move->to);
+			movePiece(S::rookFrom[move->to < move->from], S::rookTo[move->to < move->from]);
+			if (color == Piece::WHITE) {
+				whiteCastle = 0;
+			}
+			else {
+				blackCastle = 0;
+			}
+			break;
 
-	if (move->type == 4) {
-		board[move->to] = Piece::QUEEN | colorToMove;
-		board[move->from] = Piece::NONE;
-	}
-	if (move->type == 5) {
-		board[move->to] = Piece::KNIGHT | colorToMove;
-		board[move->from] = Piece::NONE;
-	}
-	if (move->type == 6) {
-		board[move->to] = Piece::BISHOP | colorToMove;
-		board[move->from] = Piece::NONE;
+		// promotions: the pawn leaves first so the piece list never overflows
+		default:
+			setSquare(move->from, Piece::NONE);
+			setSquare(move->to, promotionPieces[move->type - 4] | color);
+			break;
 	}
-	if (move->type == 7) {
-		board[move->to] = Piece::ROOK | colorToMove;
-		board[move->from] = Piece::NONE;
+
+	hash ^= Zobrist::castlingKeys[whiteCastle | blackCastle << 2];
+	if (isSquareValid(enPassant)) {
+		hash ^= Zobrist::enPassantKeys[enPassant % 16];
 	}
 
 	// filter out illegal moves
-	if (isInCheck(kingPosition[colorIndex], 24 - colorToMove)) {
+	if (isAttackedBy<S::enemy>(kingPosition[S::index])) {
 		return 0;
 	}
 
-	if (colorToMove == Piece::BLACK) {
+	if (color == Piece::BLACK) {
 		fullMoves++;
 	}
 
 	// Toggle between White and Black
-	colorToMove = 24 - colorToMove;
+	colorToMove = S::enemy;
+	hash ^= Zobrist::blackToMoveKey;
 
 	return 1;
 }
 
-// Returns true if squarePos is under attack by a piece of color: color
+// Update board with move; returns true if legal
+bool Board::makeMove(Move* move) {
+	return colorToMove == Piece::WHITE ? makeMoveAs<Piece::WHITE>(move) : makeMoveAs<Piece::BLACK>(move);
+}
+
+// isInCheck for attacker color
+template <unsigned char color>
+bool Board::isAttackedBy(unsigned char squarePos) {
+	PROFILE_SCOPE(Profiler::IS_IN_CHECK);
+#ifdef ATTACK_MAPS
+	return attackCounts[Side<color>::index][mapIndex(squarePos)] != 0;
+#else
+	const unsigned char* locations = pieceLocations[Side<color>::index];
+	for (int i = 0; i < 16; i++) {
+		unsigned char from = locations[i];
+		if (!isSquareValid(from)) {
+			continue;
+		}
+		int difference = from - squarePos + 119;
+		unsigned char kinds = Attacks::attackTable[difference] & Attacks::pieceKinds[board[from]];
+		if (kinds == 0) {
+			continue;
+		}
+		if (kinds & (Attacks::BISHOP | Attacks::ROOK)) {
+			// sliders need the squares in between to be empty
+			signed char step = Attacks::deltaTable[difference];
+			unsigned char pos = squarePos + step;
+			while (pos != from && board[pos] == Piece::NONE) {
+				pos += step;
+			}
+			if (pos != from) {
+				continue;
+			}
+		}
+		return 1;
+	}
+	return 0;
+#endif
+}
+
+// Returns true if squarePos is under attack by a piece of color: color; a single lookup when built with ATTACK_MAPS
 bool Board::isInCheck(unsigned char squarePos, unsigned char color) {
+	return color == Piece::WHITE ? isAttackedBy<Piece::WHITE>(squarePos) : isAttackedBy<Piece::BLACK>(squarePos);
+}
+
+// Same as isInCheck, scanning outward from squarePos along every ray instead of using the piece lists
+bool Board::isInCheckScan(unsigned char squarePos, unsigned char color) {
 	unsigned char endPos, endSquare;
 
 	char direction[] = {16, -16, 1, -1, 17, -17, 15, -15};
@@ -438,18 +625,18 @@ bool Board::isInCheck(unsigned char squarePos, unsigned char color) {
 }
 
 // Performance test; returns number of positions reached in given depth
-int Board::perft(int depth) {
+unsigned long long Board::perft(int depth) {
 	if (depth == 0) {
 		return 1;
 	}
 
 	Board currentPosition = *this;
 	MoveList moves = GenerateMoves();
-	int numPositions = 0;
+	unsigned long long numPositions = 0;
 	Move* currentMove;
 	while ((currentMove = moves.pop_front()) != nullptr) {
 		if (makeMove(currentMove)) {
-			int positions = perft(depth - 1);
+			unsigned long long positions = perft(depth - 1);
 			if (depth == this->depth) {
 				printf("%s -> ", indexToString(currentMove->from));
 				printf("%s", indexToString(currentMove->to));
@@ -467,7 +654,7 @@ int Board::perft(int depth) {
 						printf("=R");
 					}
 				}
-				printf(": %d\n", positions);
+				printf(": %llu\n", positions);
 			}
 			numPositions += positions;
 		}
@@ -478,20 +665,71 @@ int Board::perft(int depth) {
 
 // Minimax-style algorithm with pruning; returns best move found
 double Board::alphaBeta(Move &bestMove, int depth, double alpha, double beta, bool maximizingPlayer) {
+	TranspositionTable* table = nullptr;
+	if (searchInfo != nullptr) {
+		searchInfo->nodes++;
+		if (searchInfo->nodeLimit != 0 && searchInfo->nodes >= searchInfo->nodeLimit) {
+			searchInfo->stop = true;
+		}
+		if ((searchInfo->nodes & 1023) == 0 && searchInfo->deadline != 0 && SearchInfo::now() >= searchInfo->deadline) {
+			searchInfo->stop = true;
+		}
+		// the first iteration is too small to interrupt and guarantees a move
+		if (searchInfo->stop && this->depth > 1) {
+			return 0;
+		}
+		table = searchInfo->table;
+	}
+
 	if (depth == 0) {
-		return evaluatePosition();
+		double value = evaluatePosition();
+		TRACE_EVENT(Trace::EVAL, 0, hash, 0, this->depth, alpha, beta, value, nullptr, 0);
+		return value;
+	}
+	TRACE_EVENT(Trace::ENTER, 0, hash, depth, this->depth - depth, alpha, beta, 0, nullptr, 0);
+
+	// Draw by the 50-move rule or repetition; the root always searches so that it can report a move
+	bool root = depth == this->depth;
+	if (!root && (halfMoves >= 100 || repetitions() > 0)) {
+		TRACE_EVENT(Trace::EXIT, Trace::DRAW, hash, depth, this->depth - depth, alpha, beta, 0, nullptr, 0);
+		return 0;
+	}
+
+	// Transposition table cutoff
+	double alphaOriginal = alpha, betaOriginal = beta;
+	TTData entry;
+	bool hashHit = table != nullptr && table->probe(hash, entry);
+	if (hashHit && !root && entry.depth >= depth) {
+		if (entry.bound == TranspositionTable::EXACT
+			|| (entry.bound == TranspositionTable::LOWER && entry.score >= beta)
+			|| (entry.bound == TranspositionTable::UPPER && entry.score <= alpha)) {
+			TRACE_EVENT(Trace::EXIT, Trace::HASH_HIT, hash, depth, this->depth - depth, alpha, beta, entry.score, &entry.move, 0);
+			return entry.score;
+		}
 	}
 
 	MoveList moves = GenerateMoves();
+	if (hashHit) {
+		moves.prioritize(entry.move);
+	}
 
 	double bestValue = maximizingPlayer ? -1001 : 1001;
+	Move nodeBestMove;
 	bool terminal = true;
+	int searched = 0; // legal moves searched so far
+#ifdef TRACE
+	int bestIndex = 0; // only recorded in the exit event
+#endif
 	Board currentPosition = *this;
 
 	Move* currentMove;
 	while ((currentMove = moves.pop_front()) != nullptr) {
 		double value;
 
+		if (root && searchInfo != nullptr && searchInfo->excludedCount > 0 && isExcluded(*currentMove)) {
+			continue;
+		}
+
 		// make move
 		if (!makeMove(currentMove)) {
 			*this = currentPosition;
@@ -500,12 +738,18 @@ double Board::alphaBeta(Move &bestMove, int depth, double alpha, double beta, bo
 		terminal = false;
 
 		// get value of move
+		TRACE_MOVE(currentMove, searched);
 		value = alphaBeta(bestMove, depth - 1, alpha, beta, !maximizingPlayer);
+		searched++;
 
 		// update best value and best move
 		if ((maximizingPlayer && value > bestValue) || (!maximizingPlayer && value < bestValue)) {
 			bestValue = value;
-			if (depth == this->depth) {
+			nodeBestMove = *currentMove;
+#ifdef TRACE
+			bestIndex = searched - 1;
+#endif
+			if (root) {
 				bestMove = Move(currentMove->from, currentMove->to, currentMove->type);
 			}
 		}
@@ -521,7 +765,13 @@ double Board::alphaBeta(Move &bestMove, int depth, double alpha, double beta, bo
 		// revert move
 		*this = currentPosition;
 
+		// result is discarded by the caller once the search is stopped
+		if (searchInfo != nullptr && searchInfo->stop && this->depth > 1) {
+			return bestValue;
+		}
+
 		if (alpha >= beta) {
+			TRACE_EVENT(Trace::CUTOFF, 0, hash, depth, this->depth - depth, alpha, beta, value, currentMove, searched - 1);
 			break;
 		}
 	}
@@ -536,46 +786,354 @@ double Board::alphaBeta(Move &bestMove, int depth, double alpha, double beta, bo
 			}
 		}
 
+		bestValue = 0;
 		if (isInCheck(kingPos, 24 - colorToMove)) {
-			if (colorToMove == Piece::WHITE) {
-				return -1000;
+			bestValue = colorToMove == Piece::WHITE ? -1000 : 1000;
+		}
+		if (table != nullptr) {
+			table->store(hash, depth, bestValue, TranspositionTable::EXACT, nodeBestMove);
+		}
+		TRACE_EVENT(Trace::EXIT, TranspositionTable::EXACT, hash, depth, this->depth - depth, alphaOriginal, betaOriginal, bestValue, nullptr, 0);
+		return bestValue;
+	}
+
+	unsigned char bound = TranspositionTable::EXACT;
+	if (bestValue <= alphaOriginal) {
+		bound = TranspositionTable::UPPER;
+	}
+	else if (bestValue >= betaOriginal) {
+		bound = TranspositionTable::LOWER;
+	}
+
+	// a root searched with exclusions doesn't have the true value of the position
+	if (table != nullptr && !(root && searchInfo->excludedCount > 0)) {
+		table->store(hash, depth, bestValue, bound, nodeBestMove);
+	}
+
+	TRACE_EVENT(Trace::EXIT, bound, hash, depth, this->depth - depth, alphaOriginal, betaOriginal, bestValue, &nodeBestMove, bestIndex);
+	return bestValue;
+}
+
+// Searches depth 1, 2, ... up to maxDepth until searchInfo stops it; returns evaluation of the last completed depth
+double Board::iterativeDeepening(Move &bestMove, int maxDepth) {
+	PVLine line;
+	if (searchMultiPV(&line, 1, maxDepth) == 0) {
+		return 0;
+	}
+	bestMove = line.pv[0];
+	return line.score;
+}
+
+// Iterative deepening over the best count root moves; each line is searched with the first moves of the better lines excluded.
+// Returns the number of lines filled from the last completed depth
+int Board::searchMultiPV(PVLine* lines, int count, int maxDepth) {
+	SearchInfo localInfo;
+	SearchInfo* info = searchInfo != nullptr ? searchInfo : &localInfo;
+	searchInfo = info;
+
+	// at most one line per legal move
+	int legal = 0;
+	MoveList moves = GenerateMoves();
+	Move* currentMove;
+	while ((currentMove = moves.pop_front()) != nullptr) {
+		Board next = *this;
+		legal += next.makeMove(currentMove);
+	}
+	count = std::min(std::min(count, legal), int(SearchInfo::MAX_PV));
+
+	int completed = 0;
+	PVLine iteration[SearchInfo::MAX_PV];
+	for (int iterationDepth = 1; iterationDepth <= maxDepth && count > 0; iterationDepth++) {
+		// the first iteration always completes so that a move is available
+		unsigned long long nodeLimit = info->nodeLimit;
+		if (iterationDepth == 1) {
+			info->nodeLimit = 0;
+		}
+
+		depth = iterationDepth;
+		info->excludedCount = 0;
+		int found = 0;
+		for (int i = 0; i < count; i++) {
+			Move lineMove;
+			double value = alphaBeta(lineMove, iterationDepth, -INT_MAX, INT_MAX, colorToMove == Piece::WHITE);
+			if (info->stop && (iterationDepth > 1 || i > 0)) {
+				break;
 			}
-			return 1000;
+			iteration[i].score = value;
+			iteration[i].length = principalVariation(lineMove, iteration[i].pv, std::min(iterationDepth, 64));
+			info->excluded[info->excludedCount++] = lineMove;
+			found++;
 		}
+		info->excludedCount = 0;
+		info->nodeLimit = nodeLimit;
+		if (info->stop && iterationDepth > 1) {
+			break;
+		}
+
+		completed = found;
+		for (int i = 0; i < completed; i++) {
+			lines[i] = iteration[i];
+		}
+		info->pvLength = lines[0].length;
+		info->completedDepth = iterationDepth;
+		info->score = lines[0].score;
+		std::copy(lines[0].pv, lines[0].pv + lines[0].length, info->pv);
+
+		if (info->printInfo) {
+			for (int i = 0; i < completed; i++) {
+				printf("info depth %d ", iterationDepth);
+				if (count > 1) {
+					printf("multipv %d ", i + 1);
+				}
+				printf("score %.2f nodes %llu time %lld pv", lines[i].score, info->nodes, SearchInfo::now() - info->startTime);
+				for (int j = 0; j < lines[i].length; j++) {
+					char moveString[6];
+					moveToString(lines[i].pv[j], moveString);
+					printf(" %s", moveString);
+				}
+				printf("\n");
+			}
+			fflush(stdout);
+		}
+
+		// no need to search deeper than a forced mate
+		if (info->stop || int(lines[0].score) == 1000 || int(lines[0].score) == -1000) {
+			break;
+		}
+	}
+
+	if (searchInfo == &localInfo) {
+		searchInfo = nullptr;
+	}
+	return completed;
+}
+
+// Number of earlier occurrences of the position since the last pawn move or capture
+int Board::repetitions() {
+	if (history == nullptr) {
 		return 0;
 	}
 
-	return bestValue;
+	// the same side must be to move, and it takes at least four plies to get back
+	int count = 0;
+	int oldest = std::max(0, historyLength - halfMoves);
+	for (int i = historyLength - 4; i >= oldest; i -= 2) {
+		if (history->keys[i] == hash) {
+			count++;
+		}
+	}
+	return count;
 }
 
-// Returns piece value of a given piece
-int Board::pieceValue(unsigned char piece) {
-	if (piece == Piece::PAWN) {
-		return 100;
+// Returns true if move is one of the root moves excluded by a MultiPV search
+bool Board::isExcluded(const Move& move) {
+	for (int i = 0; i < searchInfo->excludedCount; i++) {
+		if (searchInfo->excluded[i] == move) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Returns bestMove followed by the hash moves that continue from it; returns the number of moves written to pv
+int Board::principalVariation(Move bestMove, Move* pv, int maxLength) {
+	Board position = *this;
+	int length = 0;
+	Move next = bestMove;
+	while (length < maxLength) {
+		// the move must be legal here, hash moves can come from colliding positions
+		MoveList moves = position.GenerateMoves();
+		if (!moves.prioritize(next) || !position.makeMove(&next)) {
+			break;
+		}
+		pv[length++] = next;
+
+		TTData entry;
+		if (searchInfo == nullptr || searchInfo->table == nullptr || !searchInfo->table->probe(position.hash, entry)) {
+			break;
+		}
+		next = entry.move;
+	}
+	return length;
+}
+
+// Writes a move in coordinate notation, i.e. "e7e8q", into buffer (at least 6 characters)
+void Board::moveToString(const Move& move, char* buffer) {
+	const char promotions[] = "qnbr";
+	buffer[0] = 'a' + move.from % 16;
+	buffer[1] = '1' + move.from / 16;
+	buffer[2] = 'a' + move.to % 16;
+	buffer[3] = '1' + move.to / 16;
+	buffer[4] = move.type > 3 ? promotions[move.type - 4] : '\0';
+	buffer[5] = '\0';
+}
+
+// Writes the legal moves into legal, which must have room for 218; returns how many there are
+int Board::legalMoves(Move* legal) {
+	MoveList moves = GenerateMoves();
+	int count = 0;
+	Move* currentMove;
+	while ((currentMove = moves.pop_front()) != nullptr) {
+		Board next = *this;
+		if (next.makeMove(currentMove)) {
+			legal[count++] = *currentMove;
+		}
 	}
-	else if (piece == Piece::KNIGHT) {
-		return 320;
+	return count;
+}
+
+// Finds the legal move written in standard algebraic notation, i.e. "Nbxd7+" or "O-O"; returns false if there is none or more than one
+bool Board::parseSAN(std::string_view san, Move& move) {
+	// check, mate and annotation marks
+	while (!san.empty() && std::string_view("+#!?").find(san.back()) != std::string_view::npos) {
+		san.remove_suffix(1);
 	}
-	else if (piece == Piece::BISHOP) {
-		return 330;
+
+	int castle = -1; // 0: kingside, 1: queenside
+	if (san == "O-O" || san == "0-0") {
+		castle = 0;
 	}
-	else if (piece == Piece::ROOK) {
-		return 510;
+	else if (san == "O-O-O" || san == "0-0-0") {
+		castle = 1;
 	}
-	else if (piece == Piece::QUEEN) {
-		return 880;
+
+	unsigned char type = Piece::PAWN;
+	unsigned char promotion = 0; // move type of the promotion, 0 for none
+	int fromFile = -1, fromRank = -1;
+	unsigned char to = 0;
+	if (castle < 0) {
+		size_t piece = std::string_view("PNBRQK").find(san.empty() ? ' ' : san[0]);
+		if (piece != std::string_view::npos) {
+			type = Piece::PAWN + piece;
+			san.remove_prefix(1);
+		}
+
+		// "e8=Q", also written "e8Q"
+		size_t promoted = std::string_view("QNBR").find(san.size() < 3 ? ' ' : std::toupper(san.back()));
+		if (promoted != std::string_view::npos) {
+			promotion = 4 + promoted;
+			san.remove_suffix(san[san.size() - 2] == '=' ? 2 : 1);
+		}
+
+		if (san.size() < 2 || san[san.size() - 2] < 'a' || san[san.size() - 2] > 'h' || san.back() < '1' || san.back() > '8') {
+			return false;
+		}
+		to = (san.back() - '1') * 16 + san[san.size() - 2] - 'a';
+		san.remove_suffix(2);
+
+		// disambiguation by file, rank or both; long algebraic "Ng1-f3" names the whole square
+		for (char c : san) {
+			if (c >= 'a' && c <= 'h') {
+				fromFile = c - 'a';
+			}
+			else if (c >= '1' && c <= '8') {
+				fromRank = c - '1';
+			}
+			else if (c != 'x' && c != '-' && c != ':') {
+				return false;
+			}
+		}
 	}
-	return 0;
+
+	Move legal[256];
+	int count = legalMoves(legal);
+	int matches = 0;
+	for (int i = 0; i < count; i++) {
+		const Move& candidate = legal[i];
+		if (castle >= 0) {
+			if (candidate.type != 3 || (candidate.to < candidate.from) != (castle == 1)) {
+				continue;
+			}
+		}
+		else if ((board[candidate.from] & 0x07) != type || candidate.to != to || candidate.type == 3
+			|| (fromFile >= 0 && candidate.from % 16 != fromFile) || (fromRank >= 0 && candidate.from / 16 != fromRank)
+			|| (promotion != 0 ? candidate.type != promotion : candidate.type > 3)) {
+			continue;
+		}
+		move = candidate;
+		matches++;
+	}
+	return matches == 1;
+}
+
+// Writes a legal move in standard algebraic notation with its check or mate mark, i.e. "exd8=Q#", into buffer (at least 8 characters)
+void Board::moveToSAN(const Move& move, char* buffer) {
+	int length = 0;
+	unsigned char type = board[move.from] & 0x07;
+	Move legal[256];
+	int count = legalMoves(legal);
+
+	if (move.type == 3) {
+		length = sprintf(buffer, move.to > move.from ? "O-O" : "O-O-O");
+	}
+	else {
+		bool capture = board[move.to] != Piece::NONE || move.type == 2;
+		if (type == Piece::PAWN) {
+			if (capture) {
+				buffer[length++] = 'a' + move.from % 16;
+			}
+		}
+		else {
+			buffer[length++] = " PNBRQK"[type];
+
+			// name the file, else the rank, else both when another piece of the same type reaches the square
+			bool ambiguous = false, sameFile = false, sameRank = false;
+			for (int i = 0; i < count; i++) {
+				if (legal[i].to == move.to && legal[i].from != move.from && (board[legal[i].from] & 0x07) == type) {
+					ambiguous = true;
+					sameFile |= legal[i].from % 16 == move.from % 16;
+					sameRank |= legal[i].from / 16 == move.from / 16;
+				}
+			}
+			if (ambiguous && (!sameFile || sameRank)) {
+				buffer[length++] = 'a' + move.from % 16;
+			}
+			if (ambiguous && sameFile) {
+				buffer[length++] = '1' + move.from / 16;
+			}
+		}
+		if (capture) {
+			buffer[length++] = 'x';
+		}
+		buffer[length++] = 'a' + move.to % 16;
+		buffer[length++] = '1' + move.to / 16;
+		if (move.type > 3) {
+			buffer[length++] = '=';
+			buffer[length++] = "QNBR"[move.type - 4];
+		}
+	}
+
+	Board next = *this;
+	Move played = move;
+	next.makeMove(&played);
+	if (next.isInCheck(next.kingPosition[next.colorToMove == Piece::BLACK], colorToMove)) {
+		buffer[length++] = next.legalMoves(legal) == 0 ? '#' : '+';
+	}
+	buffer[length] = '\0';
+}
+
+// Returns piece value of a given piece
+int Board::pieceValue(unsigned char piece) {
+	if (piece > Piece::KING) {
+		return 0;
+	}
+	return PieceSquareTables::pieceValues[piece];
 }
 
 // Evaluate the current position
 double Board::evaluatePosition() {
+	PROFILE_SCOPE(Profiler::EVALUATE);
 	if (simple_search) {
 		return 0;
 	}
 
-	int evaluation = 0;
-	int totalMaterial = 0;
+	// known endings have their own evaluation; otherwise the material table supplies the phase and adjustments
+	const MaterialEntry* material = Material::probe(materialKey);
+	if (material->evaluator != nullptr) {
+		return material->evaluator(*this, material->strongSide) / 100.0;
+	}
+
+	int evaluation = material->imbalance;
 	unsigned char rank;
 	unsigned char file;
 
@@ -615,8 +1173,6 @@ double Board::evaluatePosition() {
 			break;
 		}
 
-		totalMaterial += pieceEval;
-
 		if (piece > Piece::WHITE) {
 			evaluation += pieceEval;
 		}
@@ -630,150 +1186,450 @@ double Board::evaluatePosition() {
 	file = kingPosition[0] % 16;
 	signed char kingMiddle = PieceSquareTables::kingMiddleTable[rank * 8 + file];
 	signed char kingEnd = PieceSquareTables::kingEndTable[rank * 8 + file];
-	evaluation += kingMiddle + (kingEnd - kingMiddle) * (1 - totalMaterial / 8000.0);
+	evaluation += kingMiddle + (kingEnd - kingMiddle) * material->phase;
 
 	rank = kingPosition[1] / 16;
 	file = kingPosition[1] % 16;
 	kingMiddle = PieceSquareTables::kingMiddleTable[rank * 8 + file];
 	kingEnd = PieceSquareTables::kingEndTable[rank * 8 + file];
-	evaluation -= kingMiddle + (kingEnd - kingMiddle) * (1 - totalMaterial / 8000.0);
+	evaluation -= kingMiddle + (kingEnd - kingMiddle) * material->phase;
+
+	// drawish material pulls the score of the side that is ahead toward zero
+	int scale[2];
+	Material::scaleFactors(*this, material, scale);
+	evaluation = evaluation * scale[evaluation < 0] / Material::SCALE_NORMAL;
 
 	return evaluation / 100.0;
 }
 
-// Loads a position from a FEN string
-void Board::loadPosition(std::string fen) {
-	// Reset board
-	std::memset(this, 0, sizeof(Board));
-	enPassant = -2;
+// Extracts the evaluation as sparse coefficients over the EvalWeights layout
+void Board::evaluationTerms(EvalTerms& terms) {
+	int coefficients[EvalWeights::COUNT] = {};
+
+	for (int i = 0; i < 128; i++) {
+		unsigned char piece = board[i];
+		if (piece == Piece::NONE || (piece & 0x07) == Piece::KING) {
+			continue;
+		}
+
+		unsigned char rank = i / 16;
+		unsigned char file = i % 16;
+		if (piece > Piece::WHITE) {
+			rank = 7 - rank;
+		}
+		int type = piece & 0x07;
+		int sign = piece > Piece::WHITE ? 1 : -1;
+		int tableIndex = EvalWeights::TABLES + (type - 1) * 64 + rank * 8 + file;
+
+		coefficients[EvalWeights::VALUES + type - 1] += sign;
+		coefficients[tableIndex] += sign;
+	}
+
+	terms.count = 0;
+	for (int i = 0; i < EvalWeights::KING_MIDDLE; i++) {
+		if (coefficients[i] != 0) {
+			terms.index[terms.count] = i;
+			terms.coefficient[terms.count] = coefficients[i];
+			terms.count++;
+		}
+	}
+
+	terms.kingSquare[0] = (7 - kingPosition[0] / 16) * 8 + kingPosition[0] % 16;
+	terms.kingSquare[1] = (kingPosition[1] / 16) * 8 + kingPosition[1] % 16;
+	terms.phase = Material::probe(materialKey)->phase;
+}
+
+// Loads a position from a FEN string; prints the error and leaves the board unchanged if it is invalid
+bool Board::loadPosition(std::string_view fen) {
+	FenResult result = parseFEN(fen);
+	if (!result.ok()) {
+		printf("loadPosition() error: %s at character %d\n", result.message(), result.offset);
+		return false;
+	}
+	return true;
+}
+
+static inline bool isFenSpace(char c) {
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Parses an unsigned decimal number that must fill the whole field; returns false if it doesn't or exceeds max
+static bool parseNumber(std::string_view field, unsigned int max, unsigned int& value) {
+	if (field.empty() || field.size() > 5) {
+		return false;
+	}
+	value = 0;
+	for (char c : field) {
+		if (c < '0' || c > '9') {
+			return false;
+		}
+		value = value * 10 + (c - '0');
+	}
+	return value <= max;
+}
 
-	std::istringstream iss(fen);
-	std::string token;
+// Parses a FEN or EPD string without allocating; the board is only changed if parsing succeeds
+FenResult Board::parseFEN(std::string_view fen, EpdOperations* operations) {
+	Board parsed;
+	size_t pos = 0, start = 0;
+	FenResult result = { FenResult::OK, 0 };
+	auto fail = [&result](unsigned char error, size_t offset) {
+		result.error = error;
+		result.offset = offset;
+		return result;
+	};
+	auto nextField = [&]() {
+		while (pos < fen.size() && isFenSpace(fen[pos])) {
+			pos++;
+		}
+		start = pos;
+		while (pos < fen.size() && !isFenSpace(fen[pos])) {
+			pos++;
+		}
+		return fen.substr(start, pos - start);
+	};
 
-	// Set up pieces
-	if (!std::getline(iss, token, ' ')) {
-		printf("loadGameState() error: Invalid FEN string\n");
-		exit(-1);
+	// Piece placement
+	std::string_view field = nextField();
+	if (field.empty()) {
+		return fail(FenResult::MISSING_FIELD, start);
 	}
-	unsigned char file = 0, rank = 7;
-	unsigned char pieceIndex[2] = { 0, 0 };
-	for (char c : token) {
+	int rank = 7, file = 0;
+	unsigned char pieceCount[2] = { 0, 0 }, pawnCount[2] = { 0, 0 }, kingCount[2] = { 0, 0 };
+	for (size_t i = 0; i < field.size(); i++) {
+		char c = field[i];
 		if (c == '/') {
-			file = 0;
+			if (file != 8 || rank == 0) {
+				return fail(FenResult::BAD_RANK, start + i);
+			}
 			rank--;
+			file = 0;
+			continue;
 		}
-		else if (std::isdigit(c)) {
+		if (c >= '1' && c <= '8') {
 			file += c - '0';
+			if (file > 8) {
+				return fail(FenResult::BAD_RANK, start + i);
+			}
+			continue;
 		}
-		else {
-			unsigned char color, piece;
-			color = (std::isupper(c)) ? Piece::WHITE : Piece::BLACK;
-			c = std::tolower(c);
 
-			switch (c) {
-				case 'p':
-					piece = Piece::PAWN;
-					break;
-				case 'n':
-					piece = Piece::KNIGHT;
+		unsigned char piece;
+		switch (c) {
+			case 'p': case 'P':
+				piece = Piece::PAWN;
+				break;
+			case 'n': case 'N':
+				piece = Piece::KNIGHT;
+				break;
+			case 'b': case 'B':
+				piece = Piece::BISHOP;
+				break;
+			case 'r': case 'R':
+				piece = Piece::ROOK;
+				break;
+			case 'q': case 'Q':
+				piece = Piece::QUEEN;
+				break;
+			case 'k': case 'K':
+				piece = Piece::KING;
+				break;
+			default:
+				return fail(FenResult::BAD_PIECE, start + i);
+		}
+		if (file == 8) {
+			return fail(FenResult::BAD_RANK, start + i);
+		}
+
+		bool colorIndex = c >= 'a';
+		unsigned char index = rank * 16 + file;
+		if (pieceCount[colorIndex] == 16) {
+			return fail(FenResult::TOO_MANY_PIECES, start + i);
+		}
+		parsed.pieceLocations[colorIndex][pieceCount[colorIndex]++] = index;
+
+		if (piece == Piece::PAWN) {
+			if (rank == 0 || rank == 7) {
+				return fail(FenResult::PAWN_ON_BACK_RANK, start + i);
+			}
+			if (++pawnCount[colorIndex] > 8) {
+				return fail(FenResult::TOO_MANY_PIECES, start + i);
+			}
+		}
+		if (piece == Piece::KING) {
+			if (++kingCount[colorIndex] > 1) {
+				return fail(FenResult::KING_COUNT, start + i);
+			}
+			parsed.kingPosition[colorIndex] = index;
+		}
+		parsed.board[index] = piece | (colorIndex ? Piece::BLACK : Piece::WHITE);
+		file++;
+	}
+	if (rank != 0 || file != 8) {
+		return fail(FenResult::BAD_RANK, start + field.size());
+	}
+	if (kingCount[0] != 1 || kingCount[1] != 1) {
+		return fail(FenResult::KING_COUNT, start);
+	}
+
+	// Side to move
+	field = nextField();
+	size_t sideStart = start;
+	if (field.empty()) {
+		return fail(FenResult::MISSING_FIELD, start);
+	}
+	if (field == "w") {
+		parsed.colorToMove = Piece::WHITE;
+	}
+	else if (field == "b") {
+		parsed.colorToMove = Piece::BLACK;
+	}
+	else {
+		return fail(FenResult::BAD_SIDE_TO_MOVE, start);
+	}
+
+	// Castling rights
+	field = nextField();
+	if (field.empty()) {
+		return fail(FenResult::MISSING_FIELD, start);
+	}
+	if (field != "-") {
+		for (size_t i = 0; i < field.size(); i++) {
+			unsigned char& rights = field[i] >= 'a' ? parsed.blackCastle : parsed.whiteCastle;
+			unsigned char right, king, rook;
+			switch (field[i]) {
+				case 'K':
+					right = 1, king = 4, rook = 7;
 					break;
-				case 'b':
-					piece = Piece::BISHOP;
+				case 'Q':
+					right = 2, king = 4, rook = 0;
 					break;
-				case 'r':
-					piece = Piece::ROOK;
+				case 'k':
+					right = 1, king = 116, rook = 119;
 					break;
 				case 'q':
-					piece = Piece::QUEEN;
-					break;
-				case 'k':
-					piece = Piece::KING;
+					right = 2, king = 116, rook = 112;
 					break;
 				default:
-					printf("loadGameState() error: Invalid FEN string\n");
-					exit(-1);
+					return fail(FenResult::BAD_CASTLING, start + i);
 			}
-
-			// Update the board and that piece's bitboard
-			bool colorIndex = color == Piece::BLACK;
-
-			if (piece != Piece::NONE) {
-				pieceLocations[colorIndex][pieceIndex[colorIndex]] = rank * 16 + file;
-				pieceIndex[colorIndex]++;
+			if (rights & right) {
+				return fail(FenResult::BAD_CASTLING, start + i);
 			}
-
-			if (piece == Piece::KING) {
-				kingPosition[colorIndex] = rank * 16 + file;
+			unsigned char color = field[i] >= 'a' ? Piece::BLACK : Piece::WHITE;
+			if (parsed.board[king] != (Piece::KING | color) || parsed.board[rook] != (Piece::ROOK | color)) {
+				return fail(FenResult::CASTLING_MISMATCH, start + i);
 			}
-			piece |= color;
-			board[rank * 16 + file] = piece;
-			file++;
+			rights |= right;
 		}
 	}
 
-	// Side to move
-	if (!std::getline(iss, token, ' ')) {
-		printf("loadGameState() error: Invalid FEN string\n");
-		exit(-1);
+	// En passant
+	field = nextField();
+	if (field.empty()) {
+		return fail(FenResult::MISSING_FIELD, start);
 	}
-	if (token[0] == 'w') {
-		colorToMove = Piece::WHITE;
+	if (field != "-") {
+		if (field.size() != 2 || field[0] < 'a' || field[0] > 'h') {
+			return fail(FenResult::BAD_EN_PASSANT, start);
+		}
+		// the square must be behind an opposing pawn that just moved two squares
+		bool whiteToMove = parsed.colorToMove == Piece::WHITE;
+		unsigned char index = (field[0] - 'a') + (whiteToMove ? 5 : 2) * 16;
+		char pawnStep = whiteToMove ? -16 : 16;
+		unsigned char pawn = Piece::PAWN | (whiteToMove ? Piece::BLACK : Piece::WHITE);
+		if (field[1] != (whiteToMove ? '6' : '3') || parsed.board[index] != Piece::NONE
+			|| parsed.board[index - pawnStep] != Piece::NONE || parsed.board[index + pawnStep] != pawn) {
+			return fail(FenResult::BAD_EN_PASSANT, start);
+		}
+		parsed.enPassant = index;
 	}
-	if (token[0] == 'b') {
-		colorToMove = Piece::BLACK;
+
+	// Clocks are optional so that plain EPD records load too
+	parsed.halfMoves = 0;
+	parsed.fullMoves = 1;
+	field = nextField();
+	if (!field.empty() && field[0] >= '0' && field[0] <= '9') {
+		unsigned int value;
+		if (!parseNumber(field, 255, value)) {
+			return fail(FenResult::BAD_CLOCK, start);
+		}
+		parsed.halfMoves = value;
+
+		field = nextField();
+		if (field.empty()) {
+			return fail(FenResult::MISSING_FIELD, start);
+		}
+		if (!parseNumber(field, 65535, value)) {
+			return fail(FenResult::BAD_CLOCK, start);
+		}
+		parsed.fullMoves = value;
+		field = nextField();
 	}
 
-	// Castling rights
-	if (!std::getline(iss, token, ' ')) {
-		printf("loadGameState() error: Invalid FEN string\n");
-		exit(-1);
+	// EPD operations: opcode [operand ...];
+	if (operations != nullptr) {
+		operations->count = 0;
 	}
-	for (char c : token) {
-		if (c == '-') {
+	pos = start;
+	while (true) {
+		while (pos < fen.size() && isFenSpace(fen[pos])) {
+			pos++;
+		}
+		if (pos == fen.size()) {
 			break;
 		}
-		switch (c) {
-			case 'K':
-				whiteCastle += 1;
-				break;
-			case 'Q':
-				whiteCastle += 2;
-				break;
-			case 'k':
-				blackCastle += 1;
-				break;
-			case 'q':
-				blackCastle += 2;
-				break;
-			default:
-				printf("loadGameState() error: Invalid FEN string\n");
-				exit(-1);
+
+		size_t opcodeStart = pos;
+		while (pos < fen.size() && (std::isalnum((unsigned char)fen[pos]) || fen[pos] == '_')) {
+			pos++;
+		}
+		if (pos == opcodeStart || !std::isalpha((unsigned char)fen[opcodeStart])) {
+			return fail(FenResult::BAD_OPERATION, opcodeStart);
+		}
+		std::string_view opcode = fen.substr(opcodeStart, pos - opcodeStart);
+
+		while (pos < fen.size() && isFenSpace(fen[pos])) {
+			pos++;
+		}
+		size_t operandStart = pos;
+		bool quoted = false;
+		while (pos < fen.size() && (quoted || fen[pos] != ';')) {
+			if (fen[pos] == '"') {
+				quoted = !quoted;
+			}
+			pos++;
+		}
+		if (pos == fen.size()) {
+			return fail(FenResult::BAD_OPERATION, opcodeStart);
+		}
+		size_t operandEnd = pos;
+		while (operandEnd > operandStart && isFenSpace(fen[operandEnd - 1])) {
+			operandEnd--;
+		}
+		std::string_view operand = fen.substr(operandStart, operandEnd - operandStart);
+		pos++;
+
+		// halfmove clock and fullmove number operations
+		unsigned int value;
+		if (opcode == "hmvc") {
+			if (!parseNumber(operand, 255, value)) {
+				return fail(FenResult::BAD_CLOCK, operandStart);
+			}
+			parsed.halfMoves = value;
+		}
+		if (opcode == "fmvn") {
+			if (!parseNumber(operand, 65535, value)) {
+				return fail(FenResult::BAD_CLOCK, operandStart);
+			}
+			parsed.fullMoves = value;
+		}
+
+		if (operations != nullptr) {
+			if (operations->count == 16) {
+				return fail(FenResult::TOO_MANY_OPERATIONS, opcodeStart);
+			}
+			operations->operations[operations->count++] = { opcode, operand };
 		}
 	}
 
-	// En passant
-	file = 0, rank = 0;
-	if (!std::getline(iss, token, ' ')) {
-		printf("loadGameState() error: Invalid FEN string\n");
-		exit(-1);
+#ifdef ATTACK_MAPS
+	parsed.computeAttackCounts();
+#endif
+
+	// The side that just moved can't be left in check
+	bool colorIndex = parsed.colorToMove == Piece::BLACK;
+	if (parsed.isInCheck(parsed.kingPosition[!colorIndex], parsed.colorToMove)) {
+		return fail(FenResult::OPPONENT_IN_CHECK, sideStart);
 	}
-	if (token != "-") {
-		enPassant = stringToIndex(token.c_str());
+
+	// the game history and search state belong to the board, not the position
+	parsed.hash = parsed.computeHash();
+	parsed.materialKey = parsed.computeMaterialKey();
+	parsed.history = history;
+	parsed.historyLength = 0;
+	parsed.searchInfo = searchInfo;
+	*this = parsed;
+	return result;
+}
+
+// Writes the FEN string and a terminating null into buffer, which must hold at least 96 characters; returns the length
+int Board::writeFEN(char* buffer) {
+	static const char pieceChars[] = " pnbrqk  PNBRQK";
+	char* out = buffer;
+
+	for (int rank = 7; rank >= 0; rank--) {
+		int empty = 0;
+		for (int file = 0; file < 8; file++) {
+			unsigned char piece = board[rank * 16 + file];
+			if (piece == Piece::NONE) {
+				empty++;
+				continue;
+			}
+			if (empty > 0) {
+				*out++ = '0' + empty;
+				empty = 0;
+			}
+			*out++ = pieceChars[(piece & 0x07) + (piece > Piece::WHITE ? 8 : 0)];
+		}
+		if (empty > 0) {
+			*out++ = '0' + empty;
+		}
+		if (rank > 0) {
+			*out++ = '/';
+		}
 	}
 
-	// Half moves
-	if (!std::getline(iss, token, ' ')) {
-		printf("loadGameState() error: Invalid FEN string\n");
-		exit(-1);
+	*out++ = ' ';
+	*out++ = colorToMove == Piece::WHITE ? 'w' : 'b';
+	*out++ = ' ';
+	if (whiteCastle == 0 && blackCastle == 0) {
+		*out++ = '-';
+	}
+	if (whiteCastle & 1) {
+		*out++ = 'K';
+	}
+	if (whiteCastle & 2) {
+		*out++ = 'Q';
+	}
+	if (blackCastle & 1) {
+		*out++ = 'k';
+	}
+	if (blackCastle & 2) {
+		*out++ = 'q';
 	}
-	halfMoves = std::stoi(token);
 
-	// Full moves
-	if (!std::getline(iss, token, ' ')) {
-		printf("loadGameState() error: Invalid FEN string\n");
-		exit(-1);
+	*out++ = ' ';
+	if (isSquareValid(enPassant)) {
+		*out++ = 'a' + enPassant % 16;
+		*out++ = '1' + enPassant / 16;
 	}
-	fullMoves = std::stoi(token);
+	else {
+		*out++ = '-';
+	}
+
+	unsigned int clocks[2] = { halfMoves, fullMoves };
+	for (unsigned int value : clocks) {
+		char digits[5];
+		int count = 0;
+		do {
+			digits[count++] = '0' + value % 10;
+			value /= 10;
+		} while (value > 0);
+		*out++ = ' ';
+		while (count > 0) {
+			*out++ = digits[--count];
+		}
+	}
+	*out = '\0';
+	return out - buffer;
+}
+
+// Returns the FEN string of the position
+std::string Board::toFEN() {
+	char buffer[96];
+	int length = writeFEN(buffer);
+	return std::string(buffer, length);
 }
 
 // Prints a simple ASCII board interface
@@ -5,6 +5,17 @@
 #include "Piece.h"
 #include "MoveList.h"
 #include "PieceSquareTables.h"
+#include "SearchInfo.h"
+#include "EvalTerms.h"
+#include "Fen.h"
+#include "Zobrist.h"
+
+
+// Stack of position keys for repetition detection; makeMove pushes the key of the position it leaves
+struct PositionHistory {
+	static const int CAPACITY = 1024;
+	unsigned long long keys[CAPACITY];
+};
 
 
 class Board {
@@ -18,8 +29,16 @@ public:
 	unsigned short fullMoves;
 	unsigned char depth;
 	unsigned char kingPosition[2];
-	unsigned char pieceLocations[2][16];
+	unsigned char pieceLocations[2][16]; // squares of each side's pieces; unused slots hold -2
 	bool simple_search;
+	unsigned long long hash; // Zobrist key, updated incrementally by makeMove
+	unsigned long long materialKey; // piece counts (see Material), updated incrementally by makeMove
+	PositionHistory* history; // keys of the earlier positions of the game and search; may be null
+	unsigned short historyLength;
+	SearchInfo* searchInfo; // shared by every copy of the board made during a search; may be null
+#ifdef ATTACK_MAPS
+	unsigned char attackCounts[2][64]; // [color index][rank * 8 + file]: pieces of that side attacking the square, kept up to date by setSquare and movePiece
+#endif
 
 	// Default constructor (clears board)
 	Board();
@@ -33,29 +52,104 @@ public:
 	// Converts algebraic notation to board index i.e. "f3 to 37"
 	unsigned char stringToIndex(const char* squareString);
 
+	// Recomputes the hash of the position from scratch
+	unsigned long long computeHash();
+
+	// Recomputes the material key of the position from scratch
+	unsigned long long computeMaterialKey();
+
+	// Places piece (or Piece::NONE) on a square, keeping the hash and piece lists up to date
+	void setSquare(unsigned char index, unsigned char piece);
+
+	// Moves the piece on from to the empty or enemy-occupied square to
+	void movePiece(unsigned char from, unsigned char to);
+
+#ifdef ATTACK_MAPS
+	// Number of pieces of color attacking squarePos, read from the attack maps
+	int attackers(unsigned char squarePos, unsigned char color);
+
+	// Recomputes the attack maps from scratch
+	void computeAttackCounts();
+
+	// Adds delta to the count of every square the piece on index attacks
+	void addAttacks(unsigned char index, unsigned char piece, int delta);
+
+	// Adds delta to the squares behind index on the rays of the sliders that reach it: 1 when index empties, -1 when it fills
+	void updateRaysThrough(unsigned char index, int delta);
+#endif
+
 	// Generates pseudo-legal moves
 	MoveList GenerateMoves();
 
 	// Update board with move; returns true if legal
 	bool makeMove(Move* move);
 
-	// Returns true if squarePos is under attack by a piece of color: color
+	// Writes the legal moves into legal, which must have room for 218; returns how many there are
+	int legalMoves(Move* legal);
+
+	// Returns true if squarePos is under attack by a piece of color: color; a single lookup when built with ATTACK_MAPS
 	bool isInCheck(unsigned char squarePos, unsigned char color);
 
+	// Same as isInCheck, scanning outward from squarePos along every ray instead of using the piece lists
+	bool isInCheckScan(unsigned char squarePos, unsigned char color);
+
+	// Side-specific versions of GenerateMoves, makeMove and isInCheck that the public ones dispatch to; color is the side to move,
+	// or the attacking side for isAttackedBy
+	template <unsigned char color> MoveList generateMoves();
+	template <unsigned char color> bool makeMoveAs(Move* move);
+	template <unsigned char color> bool isAttackedBy(unsigned char squarePos);
+
 	// Performance test; returns number of positions reached in given depth
-	int perft(int depth);
+	unsigned long long perft(int depth);
 
 	// Minimax-style algorithm with pruning; returns best move found
 	double alphaBeta(Move &bestMove, int depth, double alpha, double beta, bool maximizingPlayer);
 
+	// Searches depth 1, 2, ... up to maxDepth until searchInfo stops it; returns evaluation of the last completed depth
+	double iterativeDeepening(Move &bestMove, int maxDepth);
+
+	// Iterative deepening over the best count root moves; each line is searched with the first moves of the better lines excluded.
+	// Returns the number of lines filled from the last completed depth
+	int searchMultiPV(PVLine* lines, int count, int maxDepth);
+
+	// Number of earlier occurrences of the position since the last pawn move or capture
+	int repetitions();
+
+	// Returns true if move is one of the root moves excluded by a MultiPV search
+	bool isExcluded(const Move& move);
+
+	// Returns bestMove followed by the hash moves that continue from it; returns the number of moves written to pv
+	int principalVariation(Move bestMove, Move* pv, int maxLength);
+
+	// Writes a move in coordinate notation, i.e. "e7e8q", into buffer (at least 6 characters)
+	void moveToString(const Move& move, char* buffer);
+
+	// Finds the legal move written in standard algebraic notation, i.e. "Nbxd7+" or "O-O"; returns false if there is none or more than one
+	bool parseSAN(std::string_view san, Move& move);
+
+	// Writes a legal move in standard algebraic notation with its check or mate mark, i.e. "exd8=Q#", into buffer (at least 8 characters)
+	void moveToSAN(const Move& move, char* buffer);
+
 	// Returns piece value of a given piece
 	int pieceValue(unsigned char piece);
 	
 	// Evaluate the current position
 	double evaluatePosition();
 
-	// Loads a position from a FEN string
-	void loadPosition(std::string fen);
+	// Extracts the evaluation as sparse coefficients over the EvalWeights layout
+	void evaluationTerms(EvalTerms& terms);
+
+	// Loads a position from a FEN string; prints the error and leaves the board unchanged if it is invalid
+	bool loadPosition(std::string_view fen);
+
+	// Parses a FEN or EPD string without allocating; the board is only changed if parsing succeeds
+	FenResult parseFEN(std::string_view fen, EpdOperations* operations = nullptr);
+
+	// Writes the FEN string and a terminating null into buffer, which must hold at least 96 characters; returns the length
+	int writeFEN(char* buffer);
+
+	// Returns the FEN string of the position
+	std::string toFEN();
 
 	// Prints a simple ASCII board interface
 	void printBoard();
@@ -0,0 +1,192 @@
+#include "Datagen.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+
+// Buffered file writer; workers hand over whole games and a background thread does the disk I/O
+class RecordWriter {
+public:
+	RecordWriter(FILE* file) : file(file), done(false) {
+		writer = std::thread(&RecordWriter::writeLoop, this);
+	}
+
+	~RecordWriter() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			done = true;
+		}
+		ready.notify_one();
+		writer.join();
+	}
+
+	// Queues records for writing; takes ownership of their contents
+	void push(std::vector<DataRecord>& records) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			queue.emplace_back();
+			queue.back().swap(records);
+		}
+		ready.notify_one();
+	}
+
+private:
+	FILE* file;
+	bool done;
+	std::mutex mutex;
+	std::condition_variable ready;
+	std::deque<std::vector<DataRecord>> queue;
+	std::thread writer;
+
+	void writeLoop() {
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true) {
+			ready.wait(lock, [this] { return done || !queue.empty(); });
+			if (queue.empty()) {
+				break;
+			}
+			std::vector<DataRecord> records;
+			records.swap(queue.front());
+			queue.pop_front();
+
+			lock.unlock();
+			fwrite(records.data(), sizeof(DataRecord), records.size(), file);
+			lock.lock();
+		}
+		fflush(file);
+	}
+};
+
+
+// Plays self-play games until the shared position counter reaches the target
+static void playGames(DataGenerator* generator, RecordWriter* writer, std::atomic<unsigned long long>* written, unsigned int seed) {
+	std::mt19937 random(seed);
+	std::vector<DataRecord> records;
+	Move legal[218];
+	PositionHistory history;
+
+	while (*written < generator->targetPositions) {
+		Board game;
+		game.history = &history;
+		game.loadPosition("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+
+		// Randomized opening
+		bool opening = true;
+		for (int ply = 0; ply < generator->randomPlies; ply++) {
+			int count = game.legalMoves(legal);
+			if (count == 0) {
+				opening = false;
+				break;
+			}
+			game.makeMove(&legal[random() % count]);
+		}
+		if (!opening) {
+			continue;
+		}
+
+		records.clear();
+		unsigned char result = 1;
+		for (int ply = 0; ply < generator->maxPlies; ply++) {
+			if (game.legalMoves(legal) == 0) {
+				unsigned char kingPos = game.kingPosition[game.colorToMove == Piece::BLACK];
+				if (game.isInCheck(kingPos, 24 - game.colorToMove)) {
+					result = game.colorToMove == Piece::WHITE ? 0 : 2;
+				}
+				break;
+			}
+			if (game.halfMoves >= 100 || game.repetitions() >= 2) {
+				break;
+			}
+
+			SearchInfo info;
+			info.nodeLimit = generator->nodesPerMove;
+			game.searchInfo = &info;
+			Move bestMove;
+			double eval = game.iterativeDeepening(bestMove, 64);
+			game.searchInfo = nullptr;
+
+			// positions in check are not quiet enough to label
+			unsigned char kingPos = game.kingPosition[game.colorToMove == Piece::BLACK];
+			if (!game.isInCheck(kingPos, 24 - game.colorToMove)) {
+				records.push_back(DataGenerator::makeRecord(game, eval));
+			}
+			game.makeMove(&bestMove);
+		}
+
+		for (DataRecord& record : records) {
+			record.result = result;
+		}
+		*written += records.size();
+		writer->push(records);
+	}
+}
+
+
+DataGenerator::DataGenerator(int numThreads, unsigned long long nodes, unsigned long long positions) {
+	threads = numThreads;
+	nodesPerMove = nodes;
+	targetPositions = positions;
+	randomPlies = 8;
+	maxPlies = 400;
+}
+
+// Plays games on all threads until targetPositions records are written to path; returns false with a message printed if
+// there are no threads or no node limit, or if the file can't be opened
+bool DataGenerator::run(const std::string& path) {
+	// without threads the progress loop below would wait forever, and without a node limit every search runs to full depth
+	if (threads < 1 || nodesPerMove < 1) {
+		printf("Datagen needs at least one thread and one node per move\n\n");
+		return false;
+	}
+	FILE* file = fopen(path.c_str(), "wb");
+	if (file == nullptr) {
+		printf("Could not open %s\n\n", path.c_str());
+		return false;
+	}
+	setvbuf(file, nullptr, _IOFBF, 1 << 20);
+
+	std::atomic<unsigned long long> written(0);
+	auto start = std::chrono::steady_clock::now();
+	{
+		RecordWriter writer(file);
+		std::random_device seeds;
+		std::vector<std::thread> workers;
+		for (int i = 0; i < threads; i++) {
+			workers.emplace_back(playGames, this, &writer, &written, seeds());
+		}
+
+		// Progress report
+		while (written < targetPositions) {
+			std::this_thread::sleep_for(std::chrono::seconds(1));
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			printf("Positions: %llu (%.0f/s)\n", written.load(), written / seconds);
+		}
+
+		for (std::thread& worker : workers) {
+			worker.join();
+		}
+	}
+	fclose(file);
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("Wrote %llu positions in %.1fs (%.0f/s)\n\n", written.load(), seconds, written / seconds);
+	return true;
+}
+
+// Fills a record from a position
+DataRecord DataGenerator::makeRecord(const Board& position, double eval) {
+	DataRecord record;
+	record.position.encode(position);
+
+	int score = int(eval * 100);
+	record.score = std::max(-32000, std::min(32000, score));
+	record.result = 1;
+	return record;
+}
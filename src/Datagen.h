@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+#include "Board.h"
+#include "PackedPosition.h"
+
+
+// Binary training record for one searched self-play position (32 bytes)
+struct DataRecord {
+	PackedPosition position;
+	unsigned char result; // game result for white: 0 - loss, 1 - draw, 2 - win
+	short score; // search score in centipawns from white's point of view
+};
+static_assert(sizeof(DataRecord) == 32, "DataRecord must stay 32 bytes");
+
+
+// Self-play training data generator
+class DataGenerator {
+public:
+	int threads;
+	unsigned long long nodesPerMove;
+	unsigned long long targetPositions;
+	int randomPlies; // random moves played from the start position before searching
+	int maxPlies; // games longer than this are scored as draws
+
+	DataGenerator(int numThreads, unsigned long long nodes, unsigned long long positions);
+
+	// Plays games on all threads until targetPositions records are written to path; returns false with a message printed if
+	// there are no threads or no node limit, or if the file can't be opened
+	bool run(const std::string& path);
+
+	// Fills a record from a position
+	static DataRecord makeRecord(const Board& position, double eval);
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+
+// Index layout of the tunable evaluation weights
+struct EvalWeights {
+	static const int VALUES = 0; // pieceValues[PAWN..QUEEN]
+	static const int TABLES = 5; // pawnTable, knightTable, bishopTable, rookTable, queenTable; 64 each
+	static const int KING_MIDDLE = TABLES + 5 * 64;
+	static const int KING_END = KING_MIDDLE + 64;
+	static const int COUNT = KING_END + 64;
+};
+
+
+// Sparse coefficient form of evaluatePosition, in centipawns, leaving out the material table adjustments (imbalance,
+// scaling and known endings):
+// sum(coefficient[i] * weight[index[i]])
+//   + (1 - phase) * weight[KING_MIDDLE + kingSquare[0]] + phase * weight[KING_END + kingSquare[0]]
+//   - (1 - phase) * weight[KING_MIDDLE + kingSquare[1]] - phase * weight[KING_END + kingSquare[1]]
+struct EvalTerms {
+	unsigned short index[48];
+	signed char coefficient[48];
+	unsigned char count;
+	unsigned char kingSquare[2]; // table index of the white and black king
+	float phase; // 0 - middlegame, 1 - endgame
+};
@@ -0,0 +1,49 @@
+#include "Fen.h"
+
+
+// Human readable description of the error
+const char* FenResult::message() const {
+	switch (error) {
+		case OK:
+			return "no error";
+		case MISSING_FIELD:
+			return "missing field";
+		case BAD_PIECE:
+			return "invalid piece character";
+		case BAD_RANK:
+			return "ranks must cover exactly 8 files and there must be 8 of them";
+		case TOO_MANY_PIECES:
+			return "too many pieces";
+		case KING_COUNT:
+			return "each side needs exactly one king";
+		case PAWN_ON_BACK_RANK:
+			return "pawn on the first or last rank";
+		case BAD_SIDE_TO_MOVE:
+			return "side to move must be w or b";
+		case BAD_CASTLING:
+			return "invalid castling rights";
+		case CASTLING_MISMATCH:
+			return "castling rights without king and rook on their home squares";
+		case BAD_EN_PASSANT:
+			return "invalid en passant square";
+		case BAD_CLOCK:
+			return "invalid move clock";
+		case OPPONENT_IN_CHECK:
+			return "side not to move is in check";
+		case BAD_OPERATION:
+			return "invalid EPD operation";
+		case TOO_MANY_OPERATIONS:
+			return "too many EPD operations";
+	}
+	return "unknown error";
+}
+
+// Returns the operand of the first operation with the given opcode, or an empty view
+std::string_view EpdOperations::find(std::string_view opcode) const {
+	for (int i = 0; i < count; i++) {
+		if (operations[i].opcode == opcode) {
+			return operations[i].operand;
+		}
+	}
+	return std::string_view();
+}
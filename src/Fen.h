@@ -0,0 +1,48 @@
+#pragma once
+#include <string_view>
+
+
+// Outcome of parsing a FEN/EPD string
+struct FenResult {
+	static const unsigned char OK = 0;
+	static const unsigned char MISSING_FIELD = 1;
+	static const unsigned char BAD_PIECE = 2;
+	static const unsigned char BAD_RANK = 3; // a rank doesn't cover exactly 8 files, or there aren't 8 ranks
+	static const unsigned char TOO_MANY_PIECES = 4;
+	static const unsigned char KING_COUNT = 5;
+	static const unsigned char PAWN_ON_BACK_RANK = 6;
+	static const unsigned char BAD_SIDE_TO_MOVE = 7;
+	static const unsigned char BAD_CASTLING = 8;
+	static const unsigned char CASTLING_MISMATCH = 9; // rights without the king and rook on their home squares
+	static const unsigned char BAD_EN_PASSANT = 10;
+	static const unsigned char BAD_CLOCK = 11;
+	static const unsigned char OPPONENT_IN_CHECK = 12;
+	static const unsigned char BAD_OPERATION = 13;
+	static const unsigned char TOO_MANY_OPERATIONS = 14;
+
+	unsigned char error;
+	unsigned short offset; // character position where the error was found
+
+	bool ok() const {
+		return error == OK;
+	}
+
+	// Human readable description of the error
+	const char* message() const;
+};
+
+
+// EPD operation, i.e. bm Nf3; viewing the parsed string
+struct EpdOperation {
+	std::string_view opcode;
+	std::string_view operand; // everything between the opcode and ';', without surrounding spaces
+};
+
+// Fixed-capacity list of EPD operations
+struct EpdOperations {
+	EpdOperation operations[16];
+	unsigned char count;
+
+	// Returns the operand of the first operation with the given opcode, or an empty view
+	std::string_view find(std::string_view opcode) const;
+};
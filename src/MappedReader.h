@@ -0,0 +1,77 @@
+#pragma once
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+// Read-only memory-mapped view of a file of fixed-size records
+template <typename Record>
+class MappedReader {
+public:
+	MappedReader() : records(nullptr), count(0), mappedSize(0) {}
+
+	~MappedReader() {
+		close();
+	}
+
+	MappedReader(const MappedReader&) = delete;
+	MappedReader& operator=(const MappedReader&) = delete;
+
+	// Maps the file; returns false if it can't be opened or mapped. A trailing partial record is ignored
+	bool open(const char* path) {
+		close();
+		int fd = ::open(path, O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+		struct stat info;
+		if (fstat(fd, &info) != 0) {
+			::close(fd);
+			return false;
+		}
+		mappedSize = info.st_size;
+		count = mappedSize / sizeof(Record);
+		if (mappedSize > 0) {
+			void* data = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (data == MAP_FAILED) {
+				::close(fd);
+				count = mappedSize = 0;
+				return false;
+			}
+			madvise(data, mappedSize, MADV_SEQUENTIAL);
+			records = static_cast<const Record*>(data);
+		}
+		::close(fd);
+		return true;
+	}
+
+	void close() {
+		if (records != nullptr) {
+			munmap(const_cast<Record*>(records), mappedSize);
+		}
+		records = nullptr;
+		count = mappedSize = 0;
+	}
+
+	size_t size() const {
+		return count;
+	}
+
+	const Record& operator[](size_t index) const {
+		return records[index];
+	}
+
+	const Record* begin() const {
+		return records;
+	}
+
+	const Record* end() const {
+		return records + count;
+	}
+
+private:
+	const Record* records;
+	size_t count;
+	size_t mappedSize;
+};
@@ -0,0 +1,223 @@
+#include "MateSearch.h"
+#include <algorithm>
+#include <cstdlib>
+
+
+MateSearch::MateSearch(size_t megabytes) {
+	nodes = 0;
+	nodeLimit = 0;
+	aborted = false;
+	count = 1;
+	while (count * 2 * sizeof(Entry) <= megabytes * 1024 * 1024) {
+		count *= 2;
+	}
+	entries = static_cast<Entry*>(std::calloc(count, sizeof(Entry)));
+}
+
+MateSearch::~MateSearch() {
+	std::free(entries);
+}
+
+// Positions are only interchangeable with the same number of plies left
+unsigned long long MateSearch::nodeKey(const Board& position, int remaining) {
+	return position.hash ^ ((remaining + 1) * 0x9E3779B97F4A7C15ULL);
+}
+
+void MateSearch::lookup(unsigned long long key, unsigned int& proof, unsigned int& disproof) {
+	Entry& entry = entries[key & (count - 1)];
+	if (entry.key == key) {
+		proof = entry.proof;
+		disproof = entry.disproof;
+	}
+	else {
+		proof = 1;
+		disproof = 1;
+	}
+}
+
+void MateSearch::store(unsigned long long key, unsigned int proof, unsigned int disproof) {
+	Entry& entry = entries[key & (count - 1)];
+	entry.key = key;
+	entry.proof = proof;
+	entry.disproof = disproof;
+}
+
+// Legal moves to search: checks for the attacker, everything for the defender; returns how many were found
+int MateSearch::generate(Board& position, bool attacker, Move* moves) {
+	MoveList pseudoLegal = position.GenerateMoves();
+	int found = 0;
+	unsigned char defender = 24 - position.colorToMove;
+	bool defenderIndex = defender == Piece::BLACK;
+	Move* currentMove;
+	while ((currentMove = pseudoLegal.pop_front()) != nullptr) {
+		Board next = position;
+		if (!next.makeMove(currentMove)) {
+			continue;
+		}
+		if (attacker && !next.isInCheck(next.kingPosition[defenderIndex], position.colorToMove)) {
+			continue;
+		}
+		moves[found++] = *currentMove;
+	}
+	return found;
+}
+
+// Expands the position until its proof or disproof number reaches the threshold
+void MateSearch::expand(Board& position, int remaining, unsigned int proofThreshold, unsigned int disproofThreshold) {
+	if (nodeLimit != 0 && nodes >= nodeLimit) {
+		aborted = true;
+		return;
+	}
+	nodes++;
+	bool attacker = remaining % 2 == 1;
+	unsigned long long key = nodeKey(position, remaining);
+
+	Move moves[218];
+	int moveCount = generate(position, attacker, moves);
+
+	// Leaves: the attacker ran out of checks or plies, or the defender is mated or stalemated
+	if (moveCount == 0 || remaining == 0) {
+		bool colorIndex = position.colorToMove == Piece::BLACK;
+		bool mated = !attacker && moveCount == 0 && position.isInCheck(position.kingPosition[colorIndex], 24 - position.colorToMove);
+		store(key, mated ? 0 : INFINITE, mated ? INFINITE : 0);
+		return;
+	}
+
+	unsigned long long childKeys[218];
+	for (int i = 0; i < moveCount; i++) {
+		Board child = position;
+		child.makeMove(&moves[i]);
+		childKeys[i] = nodeKey(child, remaining - 1);
+	}
+
+	while (true) {
+		// Attacker nodes need one proven child, defender nodes need all of them
+		unsigned long long proof = attacker ? INFINITE : 0, disproof = attacker ? 0 : INFINITE;
+		int best = 0;
+		unsigned int bestValue = INFINITE, secondValue = INFINITE;
+		unsigned int bestProof = 1, bestDisproof = 1;
+		for (int i = 0; i < moveCount; i++) {
+			unsigned int childProof, childDisproof;
+			lookup(childKeys[i], childProof, childDisproof);
+			unsigned int value = attacker ? childProof : childDisproof;
+			if (attacker) {
+				proof = std::min<unsigned long long>(proof, childProof);
+				disproof += childDisproof;
+			}
+			else {
+				proof += childProof;
+				disproof = std::min<unsigned long long>(disproof, childDisproof);
+			}
+			if (value < bestValue) {
+				secondValue = bestValue;
+				bestValue = value;
+				best = i;
+				bestProof = childProof;
+				bestDisproof = childDisproof;
+			}
+			else if (value < secondValue) {
+				secondValue = value;
+			}
+		}
+		proof = std::min<unsigned long long>(proof, INFINITE);
+		disproof = std::min<unsigned long long>(disproof, INFINITE);
+		store(key, proof, disproof);
+
+		if (proof >= proofThreshold || disproof >= disproofThreshold) {
+			return;
+		}
+
+		// Thresholds for the most promising child
+		long long childProofThreshold, childDisproofThreshold;
+		if (attacker) {
+			childProofThreshold = std::min<long long>(proofThreshold, (long long)secondValue + 1);
+			childDisproofThreshold = (long long)disproofThreshold - disproof + bestDisproof;
+		}
+		else {
+			childProofThreshold = (long long)proofThreshold - proof + bestProof;
+			childDisproofThreshold = std::min<long long>(disproofThreshold, (long long)secondValue + 1);
+		}
+		childProofThreshold = std::max(1LL, std::min<long long>(childProofThreshold, INFINITE));
+		childDisproofThreshold = std::max(1LL, std::min<long long>(childDisproofThreshold, INFINITE));
+
+		Board child = position;
+		child.makeMove(&moves[best]);
+		expand(child, remaining - 1, childProofThreshold, childDisproofThreshold);
+		if (aborted) {
+			return;
+		}
+	}
+}
+
+// Fewest plies (same parity as remaining, at most remaining) in which the attacker mates from the position, -1 if not at all
+// or if the node limit ran out
+int MateSearch::distance(Board& position, int remaining) {
+	for (int plies = remaining % 2; plies <= remaining; plies += 2) {
+		unsigned int proof, disproof;
+		unsigned long long key = nodeKey(position, plies);
+		lookup(key, proof, disproof);
+		if (proof != 0 && disproof != 0) {
+			expand(position, plies, INFINITE, INFINITE);
+			if (aborted) {
+				return -1;
+			}
+			lookup(key, proof, disproof);
+		}
+		if (proof == 0) {
+			return plies;
+		}
+	}
+	return -1;
+}
+
+// Looks for the shortest forced mate in at most moves moves; returns the length of the mating line in plies, 0 if none,
+// or -1 if the node limit ran out before the answer was known
+int MateSearch::solve(Board& position, int moves, Move* line) {
+	nodes = 0;
+	aborted = false;
+	for (int mateIn = 1; mateIn <= moves; mateIn++) {
+		int remaining = 2 * mateIn - 1;
+		unsigned int proof, disproof;
+		expand(position, remaining, INFINITE, INFINITE);
+		if (aborted) {
+			return -1;
+		}
+		lookup(nodeKey(position, remaining), proof, disproof);
+		if (proof != 0) {
+			continue;
+		}
+
+		// The attacker takes the quickest mate, the defender the slowest one
+		Board current = position;
+		int length = 0;
+		while (remaining > 0) {
+			bool attacker = remaining % 2 == 1;
+			Move candidates[218];
+			int candidateCount = generate(current, attacker, candidates);
+			int chosen = -1, chosenDistance = 0;
+			for (int i = 0; i < candidateCount; i++) {
+				Board child = current;
+				child.makeMove(&candidates[i]);
+				int plies = distance(child, remaining - 1);
+				if (aborted) {
+					return -1;
+				}
+				if (plies < 0) {
+					continue;
+				}
+				if (chosen < 0 || (attacker ? plies < chosenDistance : plies > chosenDistance)) {
+					chosen = i;
+					chosenDistance = plies;
+				}
+			}
+			if (chosen < 0) {
+				break;
+			}
+			line[length++] = candidates[chosen];
+			current.makeMove(&candidates[chosen]);
+			remaining = chosenDistance;
+		}
+		return length;
+	}
+	return 0;
+}
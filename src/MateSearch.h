@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include "Board.h"
+
+
+// Depth-first proof-number (df-pn) search for forced mates; the attacker only plays checking moves
+class MateSearch {
+public:
+	unsigned long long nodes;
+	unsigned long long nodeLimit; // 0 for none
+
+	MateSearch(size_t megabytes);
+	~MateSearch();
+
+	// Looks for the shortest forced mate in at most moves moves; returns the length of the mating line in plies, 0 if none,
+	// or -1 if the node limit ran out before the answer was known
+	int solve(Board& position, int moves, Move* line);
+
+private:
+	static const unsigned int INFINITE = 0x3FFFFFFF;
+
+	// Proof and disproof numbers of a position with a given number of plies left
+	struct Entry {
+		unsigned long long key;
+		unsigned int proof;
+		unsigned int disproof;
+	};
+
+	Entry* entries;
+	size_t count; // power of two
+	bool aborted; // the node limit ran out; the stored numbers stay valid but no result is final
+
+	unsigned long long nodeKey(const Board& position, int remaining);
+	void lookup(unsigned long long key, unsigned int& proof, unsigned int& disproof);
+	void store(unsigned long long key, unsigned int proof, unsigned int disproof);
+
+	// Legal moves to search: checks for the attacker, everything for the defender; returns how many were found
+	int generate(Board& position, bool attacker, Move* moves);
+
+	// Expands the position until its proof or disproof number reaches the threshold
+	void expand(Board& position, int remaining, unsigned int proofThreshold, unsigned int disproofThreshold);
+
+	// Fewest plies (same parity as remaining, at most remaining) in which the attacker mates from the position, -1 if not at all
+	// or if the node limit ran out
+	int distance(Board& position, int remaining);
+};
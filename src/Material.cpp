@@ -0,0 +1,309 @@
+#include <algorithm>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+#include "Material.h"
+#include "Board.h"
+
+
+// Four bits per piece type: white pawns to queens in bits 0-19, black pawns to queens in bits 20-39
+const unsigned long long Material::pieceKeys[24] = {
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 1ULL << 20, 1ULL << 24, 1ULL << 28, 1ULL << 32, 1ULL << 36, 0, 0,
+	0, 1ULL << 0, 1ULL << 4, 1ULL << 8, 1ULL << 12, 1ULL << 16, 0, 0
+};
+
+static const int KNOWN_WIN = 1000; // centipawns added to a won ending so the search heads for it
+
+static thread_local MaterialEntry table[Material::TABLE_SIZE];
+
+// KPK bitbase: one bit per (strong king, weak king, pawn on files a-d, side to move), set if the pawn side wins
+static const int KPK_SIZE = 2 * 64 * 64 * 24;
+static unsigned char kpkWins[KPK_SIZE / 8];
+static std::once_flag kpkBuilt;
+
+
+// Converts a 0x88 index to a 0-63 square
+static int square64(unsigned char index) {
+	return index / 16 * 8 + index % 16;
+}
+
+// King moves between two 0-63 squares
+static int distance(int a, int b) {
+	return std::max(std::abs(a % 8 - b % 8), std::abs(a / 8 - b / 8));
+}
+
+// 0 in the four middle squares up to 3 on the edge
+static int centerDistance(int square) {
+	return std::max(std::abs(2 * (square % 8) - 7), std::abs(2 * (square / 8) - 7)) / 2;
+}
+
+// Returns the 0-63 square of the first piece of a type on a side
+static int findPiece(const Board& position, int side, unsigned char type) {
+	for (int i = 0; i < 16; i++) {
+		unsigned char index = position.pieceLocations[side][i];
+		if ((index & 0x88) == 0 && (position.board[index] & 0x07) == type) {
+			return square64(index);
+		}
+	}
+	return -1;
+}
+
+static int kpkIndex(bool strongToMove, int weakKing, int strongKing, int pawn) {
+	return strongToMove | weakKing << 1 | strongKing << 7 | ((pawn % 8) * 6 + pawn / 8 - 1) << 13;
+}
+
+// Retrograde analysis with white owning the pawn on files a-d: positions are first marked where the result is
+// immediate, then every unknown position is resolved from its successors until nothing changes
+static void buildKPK() {
+	const unsigned char INVALID = 0, UNKNOWN = 1, DRAW = 2, WIN = 4;
+	std::vector<unsigned char> results(KPK_SIZE);
+	auto pawnAttacks = [](int pawn, int square) {
+		return square / 8 == pawn / 8 + 1 && std::abs(square % 8 - pawn % 8) == 1;
+	};
+
+	for (int index = 0; index < KPK_SIZE; index++) {
+		bool whiteToMove = index & 1;
+		int blackKing = (index >> 1) & 63, whiteKing = (index >> 7) & 63;
+		int pawn = ((index >> 13) % 6 + 1) * 8 + (index >> 13) / 6;
+		unsigned char& result = results[index];
+
+		if (distance(whiteKing, blackKing) <= 1 || whiteKing == pawn || blackKing == pawn
+			|| (whiteToMove && pawnAttacks(pawn, blackKing))) {
+			result = INVALID;
+		}
+		else if (whiteToMove && pawn / 8 == 6 && whiteKing != pawn + 8 && blackKing != pawn + 8
+			&& (distance(blackKing, pawn + 8) > 1 || distance(whiteKing, pawn + 8) == 1)) {
+			result = WIN;
+		}
+		else if (!whiteToMove && distance(blackKing, pawn) == 1 && distance(whiteKing, pawn) > 1) {
+			result = DRAW;
+		}
+		else if (!whiteToMove) {
+			bool canMove = false;
+			for (int square = 0; square < 64 && !canMove; square++) {
+				canMove = distance(square, blackKing) == 1 && distance(square, whiteKing) > 1 && !pawnAttacks(pawn, square);
+			}
+			result = canMove ? UNKNOWN : pawnAttacks(pawn, blackKing) ? WIN : DRAW;
+		}
+		else {
+			result = UNKNOWN;
+		}
+	}
+
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (int index = 0; index < KPK_SIZE; index++) {
+			if (results[index] != UNKNOWN) {
+				continue;
+			}
+			bool whiteToMove = index & 1;
+			int blackKing = (index >> 1) & 63, whiteKing = (index >> 7) & 63;
+			int pawn = ((index >> 13) % 6 + 1) * 8 + (index >> 13) / 6;
+
+			// successors that are illegal positions are classified INVALID and drop out of the union
+			unsigned char successors = 0;
+			int king = whiteToMove ? whiteKing : blackKing;
+			for (int square = 0; square < 64; square++) {
+				if (distance(square, king) == 1) {
+					successors |= whiteToMove ? results[kpkIndex(false, blackKing, square, pawn)] : results[kpkIndex(true, square, whiteKing, pawn)];
+				}
+			}
+			if (whiteToMove && pawn / 8 < 6) {
+				successors |= results[kpkIndex(false, blackKing, whiteKing, pawn + 8)];
+				if (pawn / 8 == 1 && pawn + 8 != whiteKing && pawn + 8 != blackKing) {
+					successors |= results[kpkIndex(false, blackKing, whiteKing, pawn + 16)];
+				}
+			}
+
+			unsigned char good = whiteToMove ? WIN : DRAW;
+			unsigned char bad = whiteToMove ? DRAW : WIN;
+			if (successors & good) {
+				results[index] = good;
+				changed = true;
+			}
+			else if (!(successors & UNKNOWN)) {
+				results[index] = bad;
+				changed = true;
+			}
+		}
+	}
+
+	for (int index = 0; index < KPK_SIZE; index++) {
+		if (results[index] == WIN) {
+			kpkWins[index / 8] |= 1 << (index % 8);
+		}
+	}
+}
+
+
+// Number of pieces of a code in a key
+int Material::count(unsigned long long key, unsigned char piece) {
+	return (key >> __builtin_ctzll(pieceKeys[piece])) & 15;
+}
+
+// Returns the entry of a key, computing it on the first probe in this thread
+const MaterialEntry* Material::probe(unsigned long long key) {
+	MaterialEntry& entry = table[(key * 0x9E3779B97F4A7C15ULL) >> 52];
+	if (!entry.filled || entry.key != key) {
+		compute(key, entry);
+	}
+	return &entry;
+}
+
+// Fills the scale factors of a position, checking the bishop colors when the entry asks for it
+void Material::scaleFactors(const Board& position, const MaterialEntry* entry, int scale[2]) {
+	scale[0] = entry->scale[0];
+	scale[1] = entry->scale[1];
+	if (entry->bishopsOnly) {
+		int white = findPiece(position, 0, Piece::BISHOP), black = findPiece(position, 1, Piece::BISHOP);
+		if ((white / 8 + white % 8) % 2 != (black / 8 + black % 8) % 2) {
+			scale[0] = std::min(scale[0], SCALE_OPPOSITE_BISHOPS);
+			scale[1] = std::min(scale[1], SCALE_OPPOSITE_BISHOPS);
+		}
+	}
+}
+
+// Computes the entry of a key
+void Material::compute(unsigned long long key, MaterialEntry& entry) {
+	const int* values = PieceSquareTables::pieceValues;
+	int pawns[2], knights[2], bishops[2], rooks[2], queens[2], pieces[2];
+	for (int side = 0; side < 2; side++) {
+		unsigned char color = side ? Piece::BLACK : Piece::WHITE;
+		pawns[side] = count(key, color | Piece::PAWN);
+		knights[side] = count(key, color | Piece::KNIGHT);
+		bishops[side] = count(key, color | Piece::BISHOP);
+		rooks[side] = count(key, color | Piece::ROOK);
+		queens[side] = count(key, color | Piece::QUEEN);
+		pieces[side] = knights[side] * values[Piece::KNIGHT] + bishops[side] * values[Piece::BISHOP]
+			+ rooks[side] * values[Piece::ROOK] + queens[side] * values[Piece::QUEEN];
+	}
+
+	entry = MaterialEntry();
+	entry.key = key;
+	entry.filled = true;
+	int material = pieces[0] + pieces[1] + (pawns[0] + pawns[1]) * values[Piece::PAWN];
+	entry.phase = std::max(0.0, 1 - material / 8000.0);
+	entry.imbalance = BISHOP_PAIR * ((bishops[0] >= 2) - (bishops[1] >= 2));
+	entry.bishopsOnly = bishops[0] == 1 && bishops[1] == 1 && pieces[0] == values[Piece::BISHOP] && pieces[1] == values[Piece::BISHOP];
+
+	for (int strong = 0; strong < 2; strong++) {
+		int weak = !strong;
+		entry.scale[strong] = SCALE_NORMAL;
+
+		// without pawns, an extra minor piece or less is rarely enough to win
+		if (pawns[strong] == 0 && pieces[strong] - pieces[weak] <= values[Piece::BISHOP]) {
+			entry.scale[strong] = pieces[strong] < values[Piece::ROOK] ? 0 : pieces[weak] <= values[Piece::BISHOP] ? 4 : 14;
+		}
+		bool weakBare = pawns[weak] == 0 && pieces[weak] == 0;
+		bool twoKnights = pawns[strong] == 0 && knights[strong] == 2 && pieces[strong] == 2 * values[Piece::KNIGHT];
+		if (weakBare && twoKnights) {
+			entry.scale[strong] = 0;
+			continue;
+		}
+
+		EndgameEvaluator evaluator = nullptr;
+		if (weakBare && pawns[strong] == 1 && pieces[strong] == 0) {
+			evaluator = evaluateKPK;
+		}
+		else if (weakBare && pawns[strong] == 0 && knights[strong] == 1 && bishops[strong] == 1
+			&& pieces[strong] == values[Piece::KNIGHT] + values[Piece::BISHOP]) {
+			evaluator = evaluateKBNK;
+		}
+		else if (weakBare && pieces[strong] >= values[Piece::ROOK]) {
+			evaluator = evaluateKXK;
+		}
+		else if (pawns[strong] == 0 && rooks[strong] == 1 && pieces[strong] == values[Piece::ROOK]
+			&& pawns[weak] == 1 && pieces[weak] == 0) {
+			evaluator = evaluateKRKP;
+		}
+		if (evaluator != nullptr) {
+			entry.evaluator = evaluator;
+			entry.strongSide = strong;
+		}
+	}
+}
+
+
+// King and pawn against king, from a bitbase built on first use
+int Material::evaluateKPK(const Board& position, int strong) {
+	std::call_once(kpkBuilt, buildKPK);
+
+	// seen from the pawn's side with the pawn on files a-d
+	int flip = strong ? 56 : 0;
+	int pawn = findPiece(position, strong, Piece::PAWN) ^ flip;
+	int mirror = pawn % 8 >= 4 ? 7 : 0;
+	pawn ^= mirror;
+	int strongKing = square64(position.kingPosition[strong]) ^ flip ^ mirror;
+	int weakKing = square64(position.kingPosition[!strong]) ^ flip ^ mirror;
+	bool strongToMove = position.colorToMove == (strong ? Piece::BLACK : Piece::WHITE);
+
+	int score = probeKPK(strongKing, pawn, weakKing, strongToMove) ? KNOWN_WIN / 2 + 20 * (pawn / 8) : 0;
+	return strong ? -score : score;
+}
+
+// Returns true if the KPK bitbase says the side with the pawn wins
+bool Material::probeKPK(int strongKing, int pawn, int weakKing, bool strongToMove) {
+	int index = kpkIndex(strongToMove, weakKing, strongKing, pawn);
+	return kpkWins[index / 8] & (1 << (index % 8));
+}
+
+// King, bishop and knight against king: drives the defending king into a corner of the bishop's color
+int Material::evaluateKBNK(const Board& position, int strong) {
+	int bishop = findPiece(position, strong, Piece::BISHOP);
+	int strongKing = square64(position.kingPosition[strong]);
+	int weakKing = square64(position.kingPosition[!strong]);
+
+	// a1 and h8 are dark, like squares whose rank and file add up to an even number
+	bool dark = (bishop / 8 + bishop % 8) % 2 == 0;
+	int corner = dark ? std::min(distance(weakKing, 0), distance(weakKing, 63)) : std::min(distance(weakKing, 7), distance(weakKing, 56));
+	int score = KNOWN_WIN + PieceSquareTables::pieceValues[Piece::KNIGHT] + PieceSquareTables::pieceValues[Piece::BISHOP]
+		+ 40 * (7 - corner) + 10 * (7 - distance(strongKing, weakKing));
+	return strong ? -score : score;
+}
+
+// King and rook against king and pawn
+int Material::evaluateKRKP(const Board& position, int strong) {
+	// seen from the rook's side, so the pawn runs down the board
+	int flip = strong ? 56 : 0;
+	int strongKing = square64(position.kingPosition[strong]) ^ flip;
+	int weakKing = square64(position.kingPosition[!strong]) ^ flip;
+	int rook = findPiece(position, strong, Piece::ROOK) ^ flip;
+	int pawn = findPiece(position, !strong, Piece::PAWN) ^ flip;
+	int queening = pawn % 8;
+	bool strongToMove = position.colorToMove == (strong ? Piece::BLACK : Piece::WHITE);
+	int rookValue = PieceSquareTables::pieceValues[Piece::ROOK];
+
+	int score;
+	if (strongKing % 8 == pawn % 8 && strongKing < pawn) {
+		// the king is in front of the pawn
+		score = rookValue - distance(strongKing, pawn);
+	}
+	else if (distance(weakKing, pawn) >= 3 + !strongToMove && distance(weakKing, rook) >= 3) {
+		// the defending king is too far away to support the pawn
+		score = rookValue - distance(strongKing, pawn);
+	}
+	else if (weakKing / 8 <= 2 && distance(weakKing, pawn) == 1 && strongKing / 8 >= 3 && distance(strongKing, pawn) > 2 + strongToMove) {
+		// an advanced pawn supported by its king while the attacking king is cut off
+		score = 40 - 4 * distance(strongKing, pawn);
+	}
+	else {
+		score = 100 - 4 * (distance(strongKing, pawn - 8) - distance(weakKing, pawn - 8) - distance(pawn, queening));
+	}
+	return strong ? -score : score;
+}
+
+// Mating material against a bare king: drives the defending king to the edge and brings the kings together
+int Material::evaluateKXK(const Board& position, int strong) {
+	int strongKing = square64(position.kingPosition[strong]);
+	int weakKing = square64(position.kingPosition[!strong]);
+	int score = KNOWN_WIN + 40 * centerDistance(weakKing) + 10 * (7 - distance(strongKing, weakKing));
+	for (int i = 0; i < 16; i++) {
+		unsigned char index = position.pieceLocations[strong][i];
+		if ((index & 0x88) == 0) {
+			score += PieceSquareTables::pieceValues[position.board[index] & 0x07];
+		}
+	}
+	return strong ? -score : score;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+class Board;
+
+
+// Scores a known ending in centipawns for white; strong is the index of the side that has the extra material
+typedef int (*EndgameEvaluator)(const Board& position, int strong);
+
+// Evaluation data that depends only on the material on the board
+struct MaterialEntry {
+	unsigned long long key;
+	bool filled;
+	bool bishopsOnly; // one bishop each and no other pieces besides pawns; opposite-colored bishops lower the scale
+	unsigned char strongSide; // side the evaluator plays for
+	unsigned char scale[2]; // [white, black]: multiplies the score out of Material::SCALE_NORMAL when that side is ahead
+	short imbalance; // centipawns for white
+	double phase; // 0 - middlegame, 1 - endgame
+	EndgameEvaluator evaluator; // replaces the whole evaluation when set
+};
+
+
+// Material signature of a position: four bits of piece count for every piece type and color, so makeMove can update
+// it by adding and subtracting, and a small per-thread table of the MaterialEntry for each signature seen
+struct Material {
+	static const int SCALE_NORMAL = 64;
+	static const int SCALE_OPPOSITE_BISHOPS = 24;
+	static const int TABLE_SIZE = 4096;
+	static const int BISHOP_PAIR = 30;
+
+	static const unsigned long long pieceKeys[24]; // [piece code]: amount the key changes by for one such piece; zero for kings
+
+	// Number of pieces of a code in a key
+	static int count(unsigned long long key, unsigned char piece);
+
+	// Returns the entry of a key, computing it on the first probe in this thread
+	static const MaterialEntry* probe(unsigned long long key);
+
+	// Fills the scale factors of a position, checking the bishop colors when the entry asks for it
+	static void scaleFactors(const Board& position, const MaterialEntry* entry, int scale[2]);
+
+	// Computes the entry of a key
+	static void compute(unsigned long long key, MaterialEntry& entry);
+
+	// King and pawn against king, from a bitbase built on first use
+	static int evaluateKPK(const Board& position, int strong);
+
+	// King, bishop and knight against king: drives the defending king into a corner of the bishop's color
+	static int evaluateKBNK(const Board& position, int strong);
+
+	// King and rook against king and pawn
+	static int evaluateKRKP(const Board& position, int strong);
+
+	// Mating material against a bare king: drives the defending king to the edge and brings the kings together
+	static int evaluateKXK(const Board& position, int strong);
+
+	// Returns true if the KPK bitbase says the side with the pawn wins
+	static bool probeKPK(int strongKing, int pawn, int weakKing, bool strongToMove);
+};
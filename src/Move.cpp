@@ -9,4 +9,8 @@ Move::Move(unsigned char startPos, unsigned char endPos, unsigned char moveType)
 	from = startPos;
 	to = endPos;
 	type = moveType;
+}
+
+bool Move::operator==(const Move& other) const {
+	return from == other.from && to == other.to && type == other.type;
 }
\ No newline at end of file
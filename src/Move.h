@@ -10,4 +10,6 @@ public:
 
 	Move();
 	Move(unsigned char startPos, unsigned char endPos, unsigned char moveType);
+
+	bool operator==(const Move& other) const;
 };
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "MoveList.h"
+#include <utility>
 
 
 MoveList::MoveList() {
@@ -21,4 +22,15 @@ Move* MoveList::pop_front() {
 
 	size--;
 	return &movesPool[size];
+}
+
+// Reorders the list so that move is popped first; returns false if it isn't in the list
+bool MoveList::prioritize(const Move& move) {
+	for (int i = 0; i < size; i++) {
+		if (movesPool[i] == move) {
+			std::swap(movesPool[i], movesPool[size - 1]);
+			return true;
+		}
+	}
+	return false;
 }
\ No newline at end of file
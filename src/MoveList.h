@@ -11,4 +11,7 @@ public:
 	MoveList();
 	void push_back(unsigned char startPos, unsigned char endPos, unsigned char moveType);
 	Move* pop_front();
+
+	// Reorders the list so that move is popped first; returns false if it isn't in the list
+	bool prioritize(const Move& move);
 };
\ No newline at end of file
@@ -0,0 +1,94 @@
+#include "PackedPosition.h"
+
+
+// Encodes a position; returns false if it has more than 32 pieces
+bool PackedPosition::encode(const Board& position) {
+	std::memset(this, 0, sizeof(PackedPosition));
+
+	int count = 0;
+	for (int square = 0; square < 64; square++) {
+		unsigned char piece = position.board[square / 8 * 16 + square % 8];
+		if (piece == Piece::NONE) {
+			continue;
+		}
+		if (count == 32) {
+			return false;
+		}
+
+		unsigned char code = (piece & 0x07) | ((piece & 0x18) == Piece::BLACK ? 8 : 0);
+		occupancy[square / 8] |= 1 << (square % 8);
+		pieces[count / 2] |= count % 2 ? code << 4 : code;
+		count++;
+	}
+
+	flags = position.whiteCastle | position.blackCastle << 2;
+	if (position.colorToMove == Piece::BLACK) {
+		flags |= 0x80;
+	}
+	enPassant = 0xFF;
+	if ((position.enPassant & 0x88) == 0) {
+		enPassant = position.enPassant / 16 * 8 + position.enPassant % 16;
+	}
+	halfMoves = position.halfMoves;
+	fullMoves[0] = position.fullMoves & 0xFF;
+	fullMoves[1] = position.fullMoves >> 8;
+	return true;
+}
+
+// Sets up a board from the encoding; returns false, leaving the board unspecified, if it isn't a position with
+// at most 32 valid pieces and one king per side
+bool PackedPosition::decode(Board& position) const {
+	// the piece codes only cover 32 squares
+	int occupied = 0;
+	for (unsigned char byte : occupancy) {
+		occupied += __builtin_popcount(byte);
+	}
+	if (occupied > 32) {
+		return false;
+	}
+	position = Board();
+
+	int count = 0;
+	int kings[2] = { 0, 0 };
+	unsigned char pieceIndex[2] = { 0, 0 };
+	for (int square = 0; square < 64; square++) {
+		if (!(occupancy[square / 8] & (1 << (square % 8)))) {
+			continue;
+		}
+
+		unsigned char code = count % 2 ? pieces[count / 2] >> 4 : pieces[count / 2] & 0x0F;
+		count++;
+		if ((code & 0x07) == 0 || (code & 0x07) > Piece::KING) {
+			return false;
+		}
+		bool colorIndex = code & 8;
+		unsigned char index = square / 8 * 16 + square % 8;
+		position.board[index] = (code & 0x07) | (colorIndex ? Piece::BLACK : Piece::WHITE);
+
+		if (pieceIndex[colorIndex] < 16) {
+			position.pieceLocations[colorIndex][pieceIndex[colorIndex]++] = index;
+		}
+		if ((code & 0x07) == Piece::KING) {
+			position.kingPosition[colorIndex] = index;
+			kings[colorIndex]++;
+		}
+	}
+	if (kings[0] != 1 || kings[1] != 1) {
+		return false;
+	}
+
+	position.whiteCastle = flags & 0x03;
+	position.blackCastle = (flags >> 2) & 0x03;
+	position.colorToMove = flags & 0x80 ? Piece::BLACK : Piece::WHITE;
+	if (enPassant != 0xFF) {
+		position.enPassant = enPassant / 8 * 16 + enPassant % 8;
+	}
+	position.halfMoves = halfMoves;
+	position.fullMoves = fullMoves[0] | fullMoves[1] << 8;
+	position.hash = position.computeHash();
+	position.materialKey = position.computeMaterialKey();
+#ifdef ATTACK_MAPS
+	position.computeAttackCounts();
+#endif
+	return true;
+}
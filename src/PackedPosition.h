@@ -0,0 +1,21 @@
+#pragma once
+#include "Board.h"
+
+
+// Fixed-size 29 byte binary position encoding
+struct PackedPosition {
+	unsigned char occupancy[8]; // bit n set if square n (a1 = 0 ... h8 = 63) is occupied, little-endian
+	unsigned char pieces[16]; // 4-bit code per occupied square in square order, low nibble first: piece type | 8 if black
+	unsigned char flags; // bits 0-1: whiteCastle, bits 2-3: blackCastle, bit 7: black to move
+	unsigned char enPassant; // square 0 - 63, 0xFF if none
+	unsigned char halfMoves;
+	unsigned char fullMoves[2]; // little-endian
+
+	// Encodes a position; returns false if it has more than 32 pieces
+	bool encode(const Board& position);
+
+	// Sets up a board from the encoding; returns false, leaving the board unspecified, if it isn't a position with
+	// at most 32 valid pieces and one king per side
+	bool decode(Board& position) const;
+};
+static_assert(sizeof(PackedPosition) == 29, "PackedPosition must stay unpadded");
@@ -0,0 +1,249 @@
+#include "Pgn.h"
+#include <cctype>
+#include "Board.h"
+
+
+// Value of a tag, or an empty string if the game doesn't have it
+std::string PgnGame::tag(const std::string& name) const {
+	for (const auto& tag : tags) {
+		if (tag.first == name) {
+			return tag.second;
+		}
+	}
+	return "";
+}
+
+// Sets a tag, replacing its value if it is already present
+void PgnGame::setTag(const std::string& name, const std::string& value) {
+	for (auto& tag : tags) {
+		if (tag.first == name) {
+			tag.second = value;
+			return;
+		}
+	}
+	tags.emplace_back(name, value);
+}
+
+// FEN of the starting position: the FEN tag if there is one, else the standard start
+std::string PgnGame::startFEN() const {
+	std::string fen = tag("FEN");
+	return fen.empty() ? "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1" : fen;
+}
+
+// Export format text of the game: tags, the movetext wrapped at 80 columns and a blank line
+std::string PgnGame::format() const {
+	std::string text;
+	for (const auto& tag : tags) {
+		text += "[" + tag.first + " \"";
+		for (char c : tag.second) {
+			if (c == '"' || c == '\\') {
+				text += '\\';
+			}
+			text += c;
+		}
+		text += "\"]\n";
+	}
+	text += "\n";
+
+	// move numbers continue from the starting position
+	Board start;
+	int number = 1;
+	bool black = false;
+	if (start.parseFEN(startFEN()).ok()) {
+		number = start.fullMoves;
+		black = start.colorToMove == Piece::BLACK;
+	}
+
+	std::vector<std::string> tokens;
+	if (!comment.empty()) {
+		tokens.push_back("{" + comment + "}");
+	}
+	for (size_t i = 0; i < moves.size(); i++) {
+		if (!black) {
+			tokens.push_back(std::to_string(number) + ".");
+		}
+		else if (i == 0 || !moves[i - 1].comment.empty()) {
+			tokens.push_back(std::to_string(number) + "...");
+		}
+		tokens.push_back(moves[i].san + moves[i].suffix);
+		if (!moves[i].comment.empty()) {
+			tokens.push_back("{" + moves[i].comment + "}");
+		}
+		if (black) {
+			number++;
+		}
+		black = !black;
+	}
+	tokens.push_back(result.empty() ? "*" : result);
+
+	size_t lineLength = 0;
+	for (const std::string& token : tokens) {
+		if (lineLength > 0 && lineLength + 1 + token.size() > 79) {
+			text += "\n";
+			lineLength = 0;
+		}
+		else if (lineLength > 0) {
+			text += " ";
+			lineLength++;
+		}
+		text += token;
+		lineLength += token.size();
+	}
+	text += "\n\n";
+	return text;
+}
+
+
+PgnReader::PgnReader(FILE* file) : file(file) {
+}
+
+// Returns the next character that isn't white space, or EOF
+int PgnReader::skipSpace() {
+	int c;
+	while ((c = getc(file)) != EOF && std::isspace(c)) {
+	}
+	return c;
+}
+
+// Reads up to the closing character, which is consumed; returns the text before it
+std::string PgnReader::readUntil(int end) {
+	std::string text;
+	int c;
+	while ((c = getc(file)) != EOF && c != end) {
+		text += c == '\n' || c == '\r' ? ' ' : char(c);
+	}
+	return text;
+}
+
+// Reads a tag pair after its opening bracket
+void PgnReader::readTag(PgnGame& game) {
+	std::string name;
+	int c = skipSpace();
+	while (c != EOF && !std::isspace(c) && c != '"' && c != ']') {
+		name += c;
+		c = getc(file);
+	}
+	while (c != EOF && c != '"' && c != ']') {
+		c = getc(file);
+	}
+
+	std::string value;
+	if (c == '"') {
+		while ((c = getc(file)) != EOF && c != '"' && c != '\n') {
+			if (c == '\\') {
+				c = getc(file);
+			}
+			value += c;
+		}
+		while (c != EOF && c != ']' && c != '\n') {
+			c = getc(file);
+		}
+	}
+	if (!name.empty()) {
+		game.tags.emplace_back(name, value);
+	}
+}
+
+// Skips a variation after its opening parenthesis, including nested ones and their comments
+void PgnReader::skipVariation() {
+	int depth = 1, c;
+	while (depth > 0 && (c = getc(file)) != EOF) {
+		if (c == '(') {
+			depth++;
+		}
+		else if (c == ')') {
+			depth--;
+		}
+		else if (c == '{') {
+			readUntil('}');
+		}
+		else if (c == ';') {
+			readUntil('\n');
+		}
+	}
+}
+
+// Reads the next game into game; returns false at the end of the file
+bool PgnReader::next(PgnGame& game) {
+	game.tags.clear();
+	game.comment.clear();
+	game.moves.clear();
+	game.result.clear();
+
+	bool found = false;
+	int c;
+	while ((c = skipSpace()) != EOF) {
+		if (c == '[') {
+			// tags after movetext start the next game; this one had no result
+			if (!game.moves.empty()) {
+				ungetc(c, file);
+				break;
+			}
+			readTag(game);
+			found = true;
+			continue;
+		}
+		if (c == '{' || c == ';') {
+			std::string text = readUntil(c == '{' ? '}' : '\n');
+			size_t first = text.find_first_not_of(' '), last = text.find_last_not_of(' ');
+			text = first == std::string::npos ? "" : text.substr(first, last - first + 1);
+			std::string& target = game.moves.empty() ? game.comment : game.moves.back().comment;
+			target += target.empty() || text.empty() ? text : " " + text;
+			found = true;
+			continue;
+		}
+		if (c == '(') {
+			skipVariation();
+			continue;
+		}
+		if (c == '$') {
+			while ((c = getc(file)) != EOF && std::isdigit(c)) {
+			}
+			ungetc(c, file);
+			continue;
+		}
+		if (c == '%') {
+			readUntil('\n');
+			continue;
+		}
+
+		std::string token(1, char(c));
+		while ((c = getc(file)) != EOF && !std::isspace(c) && std::string("{}()[];$").find(c) == std::string::npos) {
+			token += c;
+		}
+		ungetc(c, file);
+		found = true;
+		if (token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*") {
+			game.result = token;
+			break;
+		}
+
+		// move numbers, also written against the move as in "12.e4"
+		size_t start = token.find_first_not_of("0123456789");
+		if (start == std::string::npos) {
+			continue;
+		}
+		if (start > 0 && token[start] == '.') {
+			start = token.find_first_not_of('.', start);
+			if (start == std::string::npos) {
+				continue;
+			}
+		}
+		else {
+			start = 0; // "0-0"
+		}
+		size_t end = token.find_last_not_of("!?");
+		if (end == std::string::npos || end < start) {
+			continue;
+		}
+		game.moves.push_back({ token.substr(start, end + 1 - start), token.substr(end + 1), "" });
+	}
+
+	if (!found) {
+		return false;
+	}
+	if (game.result.empty()) {
+		game.result = game.tag("Result").empty() ? "*" : game.tag("Result");
+	}
+	return true;
+}
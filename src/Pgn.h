@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+// One mainline move of a game as written in the movetext
+struct PgnMove {
+	std::string san; // with its check or mate mark
+	std::string suffix; // annotation glyphs written after the move, i.e. "?!"
+	std::string comment; // text of the comments following the move, without braces
+};
+
+
+// One game: tag pairs in file order, the mainline and the result. Variations, NAGs and escaped lines are dropped when reading
+struct PgnGame {
+	std::vector<std::pair<std::string, std::string>> tags;
+	std::string comment; // comments before the first move
+	std::vector<PgnMove> moves;
+	std::string result; // "1-0", "0-1", "1/2-1/2" or "*"
+
+	// Value of a tag, or an empty string if the game doesn't have it
+	std::string tag(const std::string& name) const;
+
+	// Sets a tag, replacing its value if it is already present
+	void setTag(const std::string& name, const std::string& value);
+
+	// FEN of the starting position: the FEN tag if there is one, else the standard start
+	std::string startFEN() const;
+
+	// Export format text of the game: tags, the movetext wrapped at 80 columns and a blank line
+	std::string format() const;
+};
+
+
+// Streaming PGN reader; only the game being read is held in memory, so files of any size can be processed
+class PgnReader {
+public:
+	PgnReader(FILE* file);
+
+	// Reads the next game into game; returns false at the end of the file
+	bool next(PgnGame& game);
+
+private:
+	FILE* file;
+
+	// Returns the next character that isn't white space, or EOF
+	int skipSpace();
+
+	// Reads up to the closing character, which is consumed; returns the text before it
+	std::string readUntil(int end);
+
+	// Reads a tag pair after its opening bracket
+	void readTag(PgnGame& game);
+
+	// Skips a variation after its opening parenthesis, including nested ones and their comments
+	void skipVariation();
+};
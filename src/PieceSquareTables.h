@@ -2,6 +2,12 @@
 
 
 struct PieceSquareTables {
+	// Bump when the evaluation changes in a way these tables don't show; transposition table files remember it
+	static constexpr int evalVersion = 1;
+
+	// Indexed by piece type
+	static constexpr int pieceValues[7] = { 0, 100, 320, 330, 510, 880, 0 };
+
 	static constexpr signed char pawnTable[64] = {
 		 0,  0,  0,  0,  0,  0,  0,  0,
 		50, 50, 50, 50, 50, 50, 50, 50,
@@ -0,0 +1,147 @@
+#include "Profiler.h"
+#include <chrono>
+#include <cstdio>
+
+#ifdef PROFILE
+#include <atomic>
+#include <mutex>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+
+// Cheapest available tick counter; the tick length is calibrated against steady_clock in report
+static inline unsigned long long ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Calls and ticks per phase
+struct PhaseTotals {
+	unsigned long long calls[Profiler::PHASES] = {};
+	unsigned long long selfTicks[Profiler::PHASES] = {};
+	unsigned long long totalTicks[Profiler::PHASES] = {};
+
+	// Adds other to these totals and zeroes other
+	void take(PhaseTotals& other) {
+		for (int phase = 0; phase < Profiler::PHASES; phase++) {
+			calls[phase] += other.calls[phase];
+			selfTicks[phase] += other.selfTicks[phase];
+			totalTicks[phase] += other.totalTicks[phase];
+			other.calls[phase] = other.selfTicks[phase] = other.totalTicks[phase] = 0;
+		}
+	}
+};
+
+// Counters of one thread; registered so that report can sum them. They are atomic because report takes them while the
+// thread is still counting
+struct ThreadCounters {
+	std::atomic<unsigned long long> calls[Profiler::PHASES] = {};
+	std::atomic<unsigned long long> selfTicks[Profiler::PHASES] = {};
+	std::atomic<unsigned long long> totalTicks[Profiler::PHASES] = {};
+
+	ThreadCounters();
+	~ThreadCounters();
+
+	// Adds these counters to totals and zeroes them
+	void drain(PhaseTotals& totals) {
+		for (int phase = 0; phase < Profiler::PHASES; phase++) {
+			totals.calls[phase] += calls[phase].exchange(0, std::memory_order_relaxed);
+			totals.selfTicks[phase] += selfTicks[phase].exchange(0, std::memory_order_relaxed);
+			totals.totalTicks[phase] += totalTicks[phase].exchange(0, std::memory_order_relaxed);
+		}
+	}
+};
+
+static std::mutex registryMutex;
+static std::vector<ThreadCounters*> registry;
+static PhaseTotals retired; // counters of threads that have exited
+static thread_local ThreadCounters counters;
+static thread_local ScopedTimer* activeTimer = nullptr;
+
+// Clock and tick count at program start or the last report; the first report calibrates over the whole run so far
+static auto lastClock = std::chrono::steady_clock::now();
+static unsigned long long lastTicks = ticks();
+
+ThreadCounters::ThreadCounters() {
+	std::lock_guard<std::mutex> lock(registryMutex);
+	registry.push_back(this);
+}
+
+ThreadCounters::~ThreadCounters() {
+	std::lock_guard<std::mutex> lock(registryMutex);
+	drain(retired);
+	for (size_t i = 0; i < registry.size(); i++) {
+		if (registry[i] == this) {
+			registry.erase(registry.begin() + i);
+			break;
+		}
+	}
+}
+
+ScopedTimer::ScopedTimer(int phase) {
+	this->phase = phase;
+	childTicks = 0;
+	parent = activeTimer;
+	activeTimer = this;
+	start = ticks();
+}
+
+ScopedTimer::~ScopedTimer() {
+	unsigned long long elapsed = ticks() - start;
+	counters.calls[phase].fetch_add(1, std::memory_order_relaxed);
+	counters.totalTicks[phase].fetch_add(elapsed, std::memory_order_relaxed);
+	counters.selfTicks[phase].fetch_add(elapsed - childTicks, std::memory_order_relaxed);
+	if (parent != nullptr) {
+		parent->childTicks += elapsed;
+	}
+	activeTimer = parent;
+}
+
+
+// Prints calls, self time and inclusive time per phase summed over all threads since the last report, then resets
+void Profiler::report() {
+	auto clock = std::chrono::steady_clock::now();
+	unsigned long long now = ticks();
+	double nanosecondsPerTick = std::chrono::duration<double, std::nano>(clock - lastClock).count() / double(now - lastTicks);
+	double wall = std::chrono::duration<double, std::milli>(clock - lastClock).count();
+	lastClock = clock;
+	lastTicks = now;
+
+	// other threads may still be counting; a timer that ends during the report counts towards the next one
+	PhaseTotals sum;
+	{
+		std::lock_guard<std::mutex> lock(registryMutex);
+		for (ThreadCounters* threadCounters : registry) {
+			threadCounters->drain(sum);
+		}
+		sum.take(retired);
+	}
+
+	const char* names[PHASES] = { "GenerateMoves", "makeMove", "isInCheck", "evaluatePosition" };
+	double profiled = 0;
+	for (int phase = 0; phase < PHASES; phase++) {
+		profiled += sum.selfTicks[phase] * nanosecondsPerTick / 1e6;
+	}
+	printf("%-18s %14s %12s %12s %10s %8s\n", "phase", "calls", "self ms", "total ms", "ns/call", "self %");
+	for (int phase = 0; phase < PHASES; phase++) {
+		double self = sum.selfTicks[phase] * nanosecondsPerTick / 1e6;
+		double total = sum.totalTicks[phase] * nanosecondsPerTick / 1e6;
+		double perCall = sum.calls[phase] ? total * 1e6 / sum.calls[phase] : 0;
+		printf("%-18s %14llu %12.1f %12.1f %10.1f %7.1f%%\n", names[phase], sum.calls[phase], self, total, perCall, profiled > 0 ? self * 100 / profiled : 0);
+	}
+	printf("Profiled phases: %.1f ms of %.1f ms wall time since the last report\n\n", profiled, wall);
+}
+
+#else
+
+// Prints calls, self time and inclusive time per phase summed over all threads since the last report, then resets
+void Profiler::report() {
+	printf("Profiling is compiled out; build with make ChessAI-profile\n\n");
+}
+
+#endif
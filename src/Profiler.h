@@ -0,0 +1,41 @@
+#pragma once
+
+
+// Optional per-phase profiler, compiled in with -DPROFILE (make ChessAI-profile). PROFILE_SCOPE(phase) times the rest of the
+// enclosing block in thread-local counters; nested phases are subtracted from their parent so self times add up.
+// Without PROFILE the macro expands to nothing.
+struct Profiler {
+	static const int GENERATE_MOVES = 0;
+	static const int MAKE_MOVE = 1;
+	static const int IS_IN_CHECK = 2;
+	static const int EVALUATE = 3;
+	static const int PHASES = 4;
+
+	// Prints calls, self time and inclusive time per phase summed over all threads since the last report, then resets
+	static void report();
+};
+
+#ifdef PROFILE
+
+// Times one phase from construction to destruction
+class ScopedTimer {
+public:
+	ScopedTimer(int phase);
+	~ScopedTimer();
+
+private:
+	int phase;
+	unsigned long long start;
+	unsigned long long childTicks; // spent in nested timers
+	ScopedTimer* parent;
+};
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE_SCOPE(phase) ScopedTimer PROFILE_CONCAT(profileTimer, __LINE__)(phase)
+
+#else
+
+#define PROFILE_SCOPE(phase)
+
+#endif
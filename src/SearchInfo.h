@@ -0,0 +1,56 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include "Move.h"
+
+class TranspositionTable;
+
+
+// One line of a MultiPV search
+struct PVLine {
+	double score;
+	Move pv[64];
+	int length;
+};
+
+
+// Limits and counters for one search; every Board copy made during the search points at the same instance
+struct SearchInfo {
+	static const int MAX_PV = 32;
+
+	std::atomic<bool> stop;
+	std::atomic<bool> pondering; // searching on the opponent's time; no deadline until ponderhit
+	std::atomic<long long> deadline; // milliseconds on the now() clock, 0: no time limit
+	unsigned long long nodes;
+	unsigned long long nodeLimit; // 0: no limit
+	long long startTime;
+	TranspositionTable* table; // may be null
+	bool printInfo; // print an info line after every completed iteration
+	Move pv[64]; // principal variation of the last completed iteration
+	int pvLength;
+	int completedDepth; // depth of the last completed iteration
+	double score; // evaluation of the last completed iteration
+	Move excluded[MAX_PV]; // root moves skipped by alphaBeta, the first moves of better MultiPV lines
+	int excludedCount;
+
+	SearchInfo() : stop(false), pondering(false), deadline(0), nodes(0), nodeLimit(0), startTime(now()), table(nullptr), printInfo(false), pvLength(0), completedDepth(0), score(0), excludedCount(0) {}
+
+	// Prepares for a new search, keeping the table and printInfo settings
+	void reset() {
+		stop = false;
+		pondering = false;
+		deadline = 0;
+		nodes = 0;
+		nodeLimit = 0;
+		startTime = now();
+		pvLength = 0;
+		completedDepth = 0;
+		score = 0;
+		excludedCount = 0;
+	}
+
+	// Milliseconds on a monotonic clock
+	static long long now() {
+		return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+};
@@ -0,0 +1,168 @@
+#include "Trace.h"
+#include <cstdio>
+
+#ifdef TRACE
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+
+// Records of one thread; registered so that stop can flush them
+struct ThreadBuffer {
+	TraceRecord* records;
+	int count;
+	unsigned short thread;
+	Move move; // set by setMove for the next ENTER or EVAL record
+	int moveIndex;
+
+	ThreadBuffer();
+	~ThreadBuffer();
+
+	// Appends the buffered records to the file; the file mutex must be held
+	void flush();
+};
+
+static std::atomic<bool> tracing(false);
+static std::mutex fileMutex; // guards everything below
+static FILE* file = nullptr;
+static std::string filePath;
+static unsigned long long written = 0;
+static std::vector<ThreadBuffer*> registry;
+static unsigned short nextThread = 0;
+static thread_local ThreadBuffer buffer;
+
+ThreadBuffer::ThreadBuffer() {
+	records = new TraceRecord[Trace::CAPACITY];
+	count = 0;
+	moveIndex = 0;
+	std::lock_guard<std::mutex> lock(fileMutex);
+	thread = nextThread++;
+	registry.push_back(this);
+}
+
+ThreadBuffer::~ThreadBuffer() {
+	std::lock_guard<std::mutex> lock(fileMutex);
+	flush();
+	for (size_t i = 0; i < registry.size(); i++) {
+		if (registry[i] == this) {
+			registry.erase(registry.begin() + i);
+			break;
+		}
+	}
+	delete[] records;
+}
+
+// Appends the buffered records to the file; the file mutex must be held
+void ThreadBuffer::flush() {
+	if (file != nullptr && count > 0) {
+		fwrite(records, sizeof(TraceRecord), count, file);
+		written += count;
+	}
+	count = 0;
+}
+
+
+// Starts writing events to a new trace file; returns false with a message printed on failure
+bool Trace::start(const std::string& path) {
+	std::lock_guard<std::mutex> lock(fileMutex);
+	if (file != nullptr) {
+		printf("Already tracing to %s\n\n", filePath.c_str());
+		return false;
+	}
+	file = fopen(path.c_str(), "wb");
+	if (file == nullptr) {
+		printf("Could not create %s\n\n", path.c_str());
+		return false;
+	}
+	TraceHeader header;
+	std::memcpy(header.magic, "CHESSTRC", 8);
+	header.version = VERSION;
+	header.recordSize = sizeof(TraceRecord);
+	fwrite(&header, sizeof(header), 1, file);
+	filePath = path;
+	written = 0;
+	tracing = true;
+	return true;
+}
+
+// Flushes every thread's buffer and closes the file; no search may be running
+void Trace::stop() {
+	tracing = false;
+	std::lock_guard<std::mutex> lock(fileMutex);
+	if (file == nullptr) {
+		printf("Not tracing\n\n");
+		return;
+	}
+	for (ThreadBuffer* threadBuffer : registry) {
+		threadBuffer->flush();
+	}
+	fclose(file);
+	file = nullptr;
+	printf("%llu trace records written to %s\n\n", written, filePath.c_str());
+}
+
+// Appends an event to the calling thread's buffer; the move leading to ENTER and EVAL nodes comes from setMove
+void Trace::record(unsigned char kind, unsigned char bound, unsigned long long hash, int depth, int ply,
+	double alpha, double beta, double value, const Move* move, int moveIndex) {
+	if (!tracing.load(std::memory_order_relaxed)) {
+		return;
+	}
+	ThreadBuffer& threadBuffer = buffer;
+	if (threadBuffer.count == CAPACITY) {
+		std::lock_guard<std::mutex> lock(fileMutex);
+		threadBuffer.flush();
+	}
+
+	if (kind == ENTER || kind == EVAL) {
+		move = &threadBuffer.move;
+		moveIndex = threadBuffer.moveIndex;
+	}
+	TraceRecord& record = threadBuffer.records[threadBuffer.count++];
+	record.hash = hash;
+	record.alpha = alpha;
+	record.beta = beta;
+	record.value = value;
+	record.kind = kind;
+	record.bound = bound;
+	record.depth = depth;
+	record.ply = ply;
+	record.from = move != nullptr ? move->from : 0;
+	record.to = move != nullptr ? move->to : 0;
+	record.moveType = move != nullptr ? move->type : 0;
+	record.unused = 0;
+	record.moveIndex = moveIndex;
+	record.thread = threadBuffer.thread;
+}
+
+// Remembers the move about to be searched so that the child node's record carries it
+void Trace::setMove(const Move* move, int moveIndex) {
+	if (!tracing.load(std::memory_order_relaxed)) {
+		return;
+	}
+	buffer.move = *move;
+	buffer.moveIndex = moveIndex;
+}
+
+#else
+
+// Starts writing events to a new trace file; returns false with a message printed on failure
+bool Trace::start(const std::string&) {
+	printf("Tracing is compiled out; build with make ChessAI-trace\n\n");
+	return false;
+}
+
+// Flushes every thread's buffer and closes the file; no search may be running
+void Trace::stop() {
+	printf("Tracing is compiled out; build with make ChessAI-trace\n\n");
+}
+
+// Appends an event to the calling thread's buffer; the move leading to ENTER and EVAL nodes comes from setMove
+void Trace::record(unsigned char, unsigned char, unsigned long long, int, int, double, double, double, const Move*, int) {
+}
+
+// Remembers the move about to be searched so that the child node's record carries it
+void Trace::setMove(const Move*, int) {
+}
+
+#endif
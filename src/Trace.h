@@ -0,0 +1,71 @@
+#pragma once
+#include <string>
+#include "Move.h"
+
+
+// One search event (32 bytes); a trace file is a TraceHeader followed by these records, in order within each thread
+struct TraceRecord {
+	unsigned long long hash;
+	float alpha;
+	float beta;
+	float value; // EVAL: static evaluation, EXIT: node result
+	unsigned char kind;
+	unsigned char bound; // EXIT: TranspositionTable bound, or Trace::HASH_HIT / Trace::DRAW
+	unsigned char depth; // remaining depth
+	unsigned char ply;
+	unsigned char from; // ENTER and EVAL: move that led to the node; CUTOFF: cutoff move; EXIT: best move
+	unsigned char to;
+	unsigned char moveType;
+	unsigned char unused;
+	unsigned short moveIndex; // position of that move in the order the node searched its moves
+	unsigned short thread;
+};
+static_assert(sizeof(TraceRecord) == 32, "TraceRecord must stay 32 bytes");
+
+struct TraceHeader {
+	char magic[8]; // "CHESSTRC"
+	unsigned int version;
+	unsigned int recordSize;
+};
+
+
+// Optional search event trace, compiled in with -DTRACE (make ChessAI-trace). Every thread writes records into its own
+// preallocated buffer, which is appended to the trace file whenever it fills up and when tracing stops.
+// Without TRACE the TRACE_* macros expand to nothing.
+struct Trace {
+	static const unsigned char ENTER = 0; // interior node reached
+	static const unsigned char EXIT = 1; // interior node finished; not written for searches abandoned by a stop
+	static const unsigned char EVAL = 2; // leaf evaluated
+	static const unsigned char CUTOFF = 3; // alpha >= beta after a move
+
+	static const unsigned char HASH_HIT = 3; // EXIT bound of a transposition table cutoff
+	static const unsigned char DRAW = 4; // EXIT bound of a repetition or 50-move draw
+
+	static const int VERSION = 1;
+	static const int CAPACITY = 1 << 16; // records per thread buffer
+
+	// Starts writing events to a new trace file; returns false with a message printed on failure
+	static bool start(const std::string& path);
+
+	// Flushes every thread's buffer and closes the file; no search may be running
+	static void stop();
+
+	// Appends an event to the calling thread's buffer; the move leading to ENTER and EVAL nodes comes from setMove
+	static void record(unsigned char kind, unsigned char bound, unsigned long long hash, int depth, int ply,
+		double alpha, double beta, double value, const Move* move, int moveIndex);
+
+	// Remembers the move about to be searched so that the child node's record carries it
+	static void setMove(const Move* move, int moveIndex);
+};
+
+#ifdef TRACE
+
+#define TRACE_EVENT(...) Trace::record(__VA_ARGS__)
+#define TRACE_MOVE(move, moveIndex) Trace::setMove(move, moveIndex)
+
+#else
+
+#define TRACE_EVENT(...)
+#define TRACE_MOVE(move, moveIndex)
+
+#endif
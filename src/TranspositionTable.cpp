@@ -0,0 +1,253 @@
+#include "TranspositionTable.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "PieceSquareTables.h"
+#include "Zobrist.h"
+
+
+// Entry data layout: bits 0-31 score in centipawns, 32-38 from, 39-45 to, 46-48 move type, 49-55 depth, 56-57 bound, 58-63 generation
+static inline unsigned long long pack(int depth, double score, unsigned char bound, const Move& move, unsigned char generation) {
+	unsigned long long data = (unsigned int)(int)std::lround(score * 100);
+	data |= (unsigned long long)(move.from & 0x7F) << 32;
+	data |= (unsigned long long)(move.to & 0x7F) << 39;
+	data |= (unsigned long long)(move.type & 0x07) << 46;
+	data |= (unsigned long long)(depth & 0x7F) << 49;
+	data |= (unsigned long long)(bound & 0x03) << 56;
+	data |= (unsigned long long)(generation & 0x3F) << 58;
+	return data;
+}
+
+
+TranspositionTable::TranspositionTable(size_t megabytes) : generation(0) {
+	entries = nullptr;
+	count = 0;
+	mapping = nullptr;
+	mappingSize = 0;
+	resize(megabytes);
+}
+
+TranspositionTable::~TranspositionTable() {
+	release();
+}
+
+// Frees or unmaps the current entries
+void TranspositionTable::release() {
+	if (mapping != nullptr) {
+		mapping->generation = generation;
+		msync(mapping, mappingSize, MS_SYNC);
+		munmap(mapping, mappingSize);
+		mapping = nullptr;
+	}
+	else {
+		std::free(entries);
+	}
+	entries = nullptr;
+}
+
+// Reallocates the table in memory; all entries are lost and an open file is closed first
+void TranspositionTable::resize(size_t megabytes) {
+	release();
+	count = 1;
+	while (count * 2 * sizeof(Entry) <= megabytes * 1024 * 1024) {
+		count *= 2;
+	}
+	entries = static_cast<Entry*>(std::calloc(count, sizeof(Entry)));
+}
+
+// Backs the table with a memory-mapped file so entries survive between runs. A missing file is created with the given size;
+// an existing one keeps its own size and is rejected if its header doesn't match this build. Returns false with a message printed on failure
+bool TranspositionTable::open(const std::string& path, size_t megabytes) {
+	int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+	struct stat info;
+	if (fd < 0 || fstat(fd, &info) < 0) {
+		printf("Could not open %s: %s\n", path.c_str(), strerror(errno));
+		if (fd >= 0) {
+			::close(fd);
+		}
+		return false;
+	}
+
+	FileHeader header;
+	bool created = info.st_size == 0;
+	if (created) {
+		std::memset(&header, 0, sizeof(header));
+		std::memcpy(header.magic, "CHESSTT", 8);
+		header.version = FileHeader::VERSION;
+		header.entrySize = sizeof(Entry);
+		header.hashScheme = hashScheme();
+		header.evalScheme = evalScheme();
+		header.count = 1;
+		while (header.count * 2 * sizeof(Entry) <= megabytes * 1024 * 1024) {
+			header.count *= 2;
+		}
+	}
+	else {
+		// everything about the file is checked before any of it is trusted
+		const char* problem = nullptr;
+		if (size_t(info.st_size) < sizeof(header) || pread(fd, &header, sizeof(header), 0) != sizeof(header)) {
+			problem = "truncated header";
+		}
+		else if (std::memcmp(header.magic, "CHESSTT", 8) != 0) {
+			problem = "not a transposition table file";
+		}
+		else if (header.version != FileHeader::VERSION || header.entrySize != sizeof(Entry)) {
+			problem = "written by an incompatible version";
+		}
+		else if (header.hashScheme != hashScheme()) {
+			problem = "written with different hash keys";
+		}
+		else if (header.evalScheme != evalScheme()) {
+			problem = "written with a different evaluation";
+		}
+		else if (header.count == 0 || (header.count & (header.count - 1)) != 0
+			|| size_t(info.st_size) != sizeof(header) + header.count * sizeof(Entry)) {
+			problem = "size does not match its header";
+		}
+		if (problem != nullptr) {
+			printf("Rejected %s: %s\n", path.c_str(), problem);
+			::close(fd);
+			return false;
+		}
+	}
+
+	size_t size = sizeof(header) + header.count * sizeof(Entry);
+	if (created && (ftruncate(fd, size) < 0 || pwrite(fd, &header, sizeof(header), 0) != sizeof(header))) {
+		printf("Could not size %s: %s\n", path.c_str(), strerror(errno));
+		::close(fd);
+		unlink(path.c_str());
+		return false;
+	}
+	void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (memory == MAP_FAILED) {
+		printf("Could not map %s: %s\n", path.c_str(), strerror(errno));
+		return false;
+	}
+
+	release();
+	mapping = static_cast<FileHeader*>(memory);
+	mappingSize = size;
+	entries = reinterpret_cast<Entry*>(mapping + 1);
+	count = header.count;
+	generation = header.generation;
+	return true;
+}
+
+// Flushes and unmaps the file; the table continues empty in memory with the same size
+void TranspositionTable::close() {
+	if (mapping == nullptr) {
+		return;
+	}
+	size_t megabytes = count * sizeof(Entry) / (1024 * 1024);
+	resize(megabytes > 0 ? megabytes : 1);
+}
+
+// True while the table is backed by a file
+bool TranspositionTable::isPersistent() {
+	return mapping != nullptr;
+}
+
+// Fingerprint of the current Zobrist keys; files written with different keys hold unusable entries
+unsigned long long TranspositionTable::hashScheme() {
+	unsigned long long fingerprint = 0;
+	auto mix = [&fingerprint](unsigned long long key) {
+		fingerprint = (fingerprint ^ key) * 0x100000001B3ULL;
+	};
+	for (int piece = 0; piece < 24; piece++) {
+		for (int square = 0; square < 128; square++) {
+			mix(Zobrist::pieceKeys[piece][square]);
+		}
+	}
+	for (unsigned long long key : Zobrist::castlingKeys) {
+		mix(key);
+	}
+	for (unsigned long long key : Zobrist::enPassantKeys) {
+		mix(key);
+	}
+	mix(Zobrist::blackToMoveKey);
+	return fingerprint;
+}
+
+// Fingerprint of the evaluation: its version and tables. Scores stored by a different evaluation would be mixed with new ones
+unsigned long long TranspositionTable::evalScheme() {
+	unsigned long long fingerprint = 0;
+	auto mix = [&fingerprint](long long value) {
+		fingerprint = (fingerprint ^ (unsigned long long)value) * 0x100000001B3ULL;
+	};
+	mix(PieceSquareTables::evalVersion);
+	for (int value : PieceSquareTables::pieceValues) {
+		mix(value);
+	}
+	const signed char* tables[] = { PieceSquareTables::pawnTable, PieceSquareTables::knightTable, PieceSquareTables::bishopTable,
+		PieceSquareTables::rookTable, PieceSquareTables::queenTable, PieceSquareTables::kingMiddleTable, PieceSquareTables::kingEndTable };
+	for (const signed char* table : tables) {
+		for (int square = 0; square < 64; square++) {
+			mix(table[square]);
+		}
+	}
+	return fingerprint;
+}
+
+// Empties the table
+void TranspositionTable::clear() {
+	for (size_t i = 0; i < count; i++) {
+		entries[i].check.store(0, std::memory_order_relaxed);
+		entries[i].data.store(0, std::memory_order_relaxed);
+	}
+	generation = 0;
+}
+
+// Marks the start of a new search so older entries are replaced first
+void TranspositionTable::newSearch() {
+	generation = (generation + 1) & 0x3F;
+}
+
+// Returns true and fills data if the position is stored
+bool TranspositionTable::probe(unsigned long long key, TTData& data) {
+	Entry& entry = entries[key & (count - 1)];
+	unsigned long long stored = entry.data.load(std::memory_order_relaxed);
+	if ((entry.check.load(std::memory_order_relaxed) ^ stored) != key || stored == 0) {
+		return false;
+	}
+
+	data.score = (int)(stored & 0xFFFFFFFF) / 100.0;
+	data.move = Move((stored >> 32) & 0x7F, (stored >> 39) & 0x7F, (stored >> 46) & 0x07);
+	data.depth = (stored >> 49) & 0x7F;
+	data.bound = (stored >> 56) & 0x03;
+	return true;
+}
+
+// Stores a search result for the position
+void TranspositionTable::store(unsigned long long key, int depth, double score, unsigned char bound, const Move& move) {
+	Entry& entry = entries[key & (count - 1)];
+	unsigned long long stored = entry.data.load(std::memory_order_relaxed);
+	bool sameKey = (entry.check.load(std::memory_order_relaxed) ^ stored) == key;
+
+	// keep deeper results of the current search for other positions
+	if (!sameKey && ((stored >> 58) & 0x3F) == generation && int((stored >> 49) & 0x7F) > depth) {
+		return;
+	}
+
+	unsigned long long data = pack(depth, score, bound, move, generation);
+	entry.check.store(key ^ data, std::memory_order_relaxed);
+	entry.data.store(data, std::memory_order_relaxed);
+}
+
+// Approximate permille of entries written during the current search
+int TranspositionTable::hashfull() {
+	size_t sample = count < 1000 ? count : 1000;
+	int used = 0;
+	for (size_t i = 0; i < sample; i++) {
+		unsigned long long stored = entries[i].data.load(std::memory_order_relaxed);
+		if (stored != 0 && ((stored >> 58) & 0x3F) == generation) {
+			used++;
+		}
+	}
+	return used * 1000 / sample;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include "Move.h"
+
+
+// Result of a transposition table probe
+struct TTData {
+	double score;
+	Move move;
+	unsigned char depth;
+	unsigned char bound;
+};
+
+
+// Fixed-size hash table of search results; safe to share between threads
+class TranspositionTable {
+public:
+	static const unsigned char EXACT = 0;
+	static const unsigned char LOWER = 1; // score is a lower bound (fail high)
+	static const unsigned char UPPER = 2; // score is an upper bound (fail low)
+
+	TranspositionTable(size_t megabytes);
+	~TranspositionTable();
+
+	// Reallocates the table in memory; all entries are lost and an open file is closed first
+	void resize(size_t megabytes);
+
+	// Backs the table with a memory-mapped file so entries survive between runs. A missing file is created with the given size;
+	// an existing one keeps its own size and is rejected if its header doesn't match this build. Returns false with a message printed on failure
+	bool open(const std::string& path, size_t megabytes);
+
+	// Flushes and unmaps the file; the table continues empty in memory with the same size
+	void close();
+
+	// True while the table is backed by a file
+	bool isPersistent();
+
+	// Empties the table
+	void clear();
+
+	// Marks the start of a new search so older entries are replaced first
+	void newSearch();
+
+	// Returns true and fills data if the position is stored
+	bool probe(unsigned long long key, TTData& data);
+
+	// Stores a search result for the position
+	void store(unsigned long long key, int depth, double score, unsigned char bound, const Move& move);
+
+	// Approximate permille of entries written during the current search
+	int hashfull();
+
+private:
+	// key is stored xor-ed with data so that torn writes from other threads fail the key check
+	struct Entry {
+		std::atomic<unsigned long long> check;
+		std::atomic<unsigned long long> data;
+	};
+
+	// Start of a table file; entries follow at offset sizeof(FileHeader)
+	struct FileHeader {
+		static const unsigned int VERSION = 3; // bump when the entry layout or score scale changes
+
+		char magic[8];
+		unsigned int version;
+		unsigned int entrySize;
+		unsigned long long hashScheme; // fingerprint of the Zobrist keys the entries were stored with
+		unsigned long long evalScheme; // fingerprint of the evaluation that scored them
+		unsigned long long count;
+		unsigned char generation;
+		unsigned char padding[23];
+	};
+
+	Entry* entries;
+	size_t count; // power of two
+	std::atomic<unsigned char> generation;
+	FileHeader* mapping; // null when the table lives in memory
+	size_t mappingSize;
+
+	// Fingerprint of the current Zobrist keys; files written with different keys hold unusable entries
+	static unsigned long long hashScheme();
+
+	// Fingerprint of the evaluation: its version and tables. Scores stored by a different evaluation would be mixed with new ones
+	static unsigned long long evalScheme();
+
+	// Frees or unmaps the current entries
+	void release();
+};
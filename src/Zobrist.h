@@ -0,0 +1,43 @@
+#pragma once
+#include <array>
+
+
+// Random keys for incremental position hashing, generated at compile time from a fixed-seed splitmix64 sequence so
+// hashes are stable between runs and builds; transposition table files depend on that
+struct ZobristKeys {
+	// Output number index (from 1) of the splitmix64 sequence; the generator's state after n steps is n + 1 times its increment
+	static constexpr unsigned long long key(int index) {
+		unsigned long long z = 0x9E3779B97F4A7C15ULL * (index + 1ULL);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		return z ^ (z >> 31);
+	}
+
+	// Piece keys come first in the sequence, 128 per piece code from 1
+	static constexpr std::array<std::array<unsigned long long, 128>, 24> pieceKeys() {
+		std::array<std::array<unsigned long long, 128>, 24> keys = {};
+		for (int piece = 1; piece < 24; piece++) {
+			for (int square = 0; square < 128; square++) {
+				keys[piece][square] = key((piece - 1) * 128 + square + 1);
+			}
+		}
+		return keys;
+	}
+
+	// Count keys of the sequence starting after the piece keys and the given number of others
+	template <size_t count>
+	static constexpr std::array<unsigned long long, count> run(int offset) {
+		std::array<unsigned long long, count> keys = {};
+		for (size_t i = 0; i < count; i++) {
+			keys[i] = key(23 * 128 + offset + i + 1);
+		}
+		return keys;
+	}
+};
+
+struct Zobrist {
+	static constexpr std::array<std::array<unsigned long long, 128>, 24> pieceKeys = ZobristKeys::pieceKeys(); // [piece code][0x88 square]; all zero for Piece::NONE
+	static constexpr std::array<unsigned long long, 16> castlingKeys = ZobristKeys::run<16>(0); // [whiteCastle | blackCastle << 2]
+	static constexpr std::array<unsigned long long, 8> enPassantKeys = ZobristKeys::run<8>(16); // [file]
+	static constexpr unsigned long long blackToMoveKey = ZobristKeys::key(23 * 128 + 24 + 1);
+};
@@ -1,11 +1,25 @@
+#include <stdexcept>
+#include "AnalysisServer.h"
+#include "AsyncSearch.h"
 #include "Board.h"
+#include "Datagen.h"
+#include "MateSearch.h"
+#include "Profiler.h"
+#include "Trace.h"
 
 
-int main() {
+int main(int argc, char** argv) {
 	std::string input;
 	Board game;
+	PositionHistory gameHistory;
+	game.history = &gameHistory;
 	Move move;
-	printf("Commands:\n\tload startpos\n\tload fen <string>\n\tprint board\n\tmove <from> <to> <type>\n\tsearch <depth>\n\tperft <depth>\n\teval\n\thelp\n\texit\n\n");
+	TranspositionTable table(16);
+	AsyncSearch search(&table);
+	if (argc > 1) {
+		table.open(argv[1], 16);
+	}
+	printf("Commands:\n\tload startpos\n\tload fen <string>\n\tprint board\n\tmove <from> <to> <type> | <san>\n\tsearch <depth>\n\tperft <depth>\n\tmate <moves> [nodes]\n\teval\n\tprofile\n\ttrace <file> | stop\n\tdatagen <threads> <nodes> <positions> <file>\n\tgo [wtime <ms>] [btime <ms>] [winc <ms>] [binc <ms>] [movestogo <n>] [movetime <ms>] [depth <n>] [nodes <n>] [multipv <n>] [infinite] [ponder]\n\tponderhit\n\tstop\n\tisready\n\thash <megabytes>\n\thashfile <path> [megabytes] | close\n\tserve unix:<path>|tcp:<port> [workers] [queue size]\n\thelp\n\texit\n\n");
 	printf("Move types:\n\t0: normal\n\t1: pawn forward 2\n\t2: en passant\n\t3: castling\n\t4: promotion:queen\n\t5: promotion:knight\n\t6: promotion:bishop\n\t7: promotion:rook\n\n");
 
 	while (true) {
@@ -18,11 +32,29 @@ int main() {
 			exit(-1);
 		}
 
+		// go runs in the background; ponderhit, stop and isready leave it running and every other command stops it first
+		if (token == "isready") {
+			printf("readyok\n");
+			fflush(stdout);
+			continue;
+		}
+		if (token == "ponderhit") {
+			search.ponderhit();
+			continue;
+		}
+		if (token == "stop") {
+			search.stop();
+			search.wait();
+			continue;
+		}
+		search.stop();
+		search.wait();
+
 		if (token == "exit") {
 			break;
 		}
 		if (token == "help") {
-			printf("Commands:\n\tload startpos\n\tload fen <string>\n\tprint board\n\tmove <from> <to> <type>\n\tsearch <depth>\n\tperft <depth>\n\teval\n\thelp\n\texit\n\n");
+			printf("Commands:\n\tload startpos\n\tload fen <string>\n\tprint board\n\tmove <from> <to> <type> | <san>\n\tsearch <depth>\n\tperft <depth>\n\tmate <moves> [nodes]\n\teval\n\tprofile\n\ttrace <file> | stop\n\tdatagen <threads> <nodes> <positions> <file>\n\tgo [wtime <ms>] [btime <ms>] [winc <ms>] [binc <ms>] [movestogo <n>] [movetime <ms>] [depth <n>] [nodes <n>] [multipv <n>] [infinite] [ponder]\n\tponderhit\n\tstop\n\tisready\n\thash <megabytes>\n\thashfile <path> [megabytes] | close\n\tserve unix:<path>|tcp:<port> [workers] [queue size]\n\thelp\n\texit\n\n");
 			printf("Move types:\n\t0: normal, 1: pawn forward 2, 2: en passant, 3: castling, 4: promotion:queen, 5: promotion:knight, 6: promotion:bishop, 7: promotion:rook\n\n");
 			continue;
 		}
@@ -54,16 +86,20 @@ int main() {
 			if (!std::getline(iss, token, ' ')) {
 				exit(-1);
 			}
-			unsigned char from = game.stringToIndex(token.c_str());
-			if (!std::getline(iss, token, ' ')) {
-				exit(-1);
+			std::string first = token;
+			if (std::getline(iss, token, ' ')) {
+				unsigned char from = game.stringToIndex(first.c_str());
+				unsigned char to = game.stringToIndex(token.c_str());
+				if (!std::getline(iss, token, ' ')) {
+					token = "0";
+				}
+				unsigned char type = token[0] - '0';
+				move = Move(from, to, type);
 			}
-			unsigned char to = game.stringToIndex(token.c_str());
-			if (!std::getline(iss, token, ' ')) {
-				token = "0";
+			// a single argument is a move in standard algebraic notation, i.e. "Nf3"
+			else if (!game.parseSAN(first, move)) {
+				move = Move(0, 0, 0);
 			}
-			unsigned char type = token[0] - '0';
-			move = Move(from, to, type);
 			MoveList moves = game.GenerateMoves();
 			bool legal_move = false;
 			Board currentPosition = game;
@@ -81,6 +117,12 @@ int main() {
 			if (!legal_move) {
 				printf("Illegal move\n\n");
 			}
+			else if (game.halfMoves >= 100) {
+				printf("Draw by the 50-move rule\n\n");
+			}
+			else if (game.repetitions() >= 2) {
+				printf("Draw by threefold repetition\n\n");
+			}
 			continue;
 		}
 		if (token == "perft") {
@@ -90,7 +132,7 @@ int main() {
 			unsigned char depth = token[0] - '0';
 			game.depth = depth;
 			clock_t start_time = clock();
-			printf("Depth: %d\nPositions: %d\n", game.depth, game.perft(game.depth));
+			printf("Depth: %d\nPositions: %llu\n", game.depth, game.perft(game.depth));
 			clock_t end_time = clock();
 			double elapsed_time = (double)(end_time - start_time) / CLOCKS_PER_SEC;
 			printf("Time: %.3f\n\n", elapsed_time);
@@ -136,6 +178,169 @@ int main() {
 			printf("\nTime: %.3f\n\n", elapsed_time);
 			continue;
 		}
+		if (token == "profile") {
+			Profiler::report();
+			continue;
+		}
+		if (token == "trace") {
+			std::string path;
+			if (!(iss >> path)) {
+				exit(-1);
+			}
+			if (path == "stop") {
+				Trace::stop();
+			}
+			else if (Trace::start(path)) {
+				printf("Tracing search events to %s\n\n", path.c_str());
+			}
+			continue;
+		}
+		if (token == "hashfile") {
+			std::string path;
+			if (!(iss >> path)) {
+				exit(-1);
+			}
+			if (path == "close") {
+				table.close();
+				continue;
+			}
+			size_t megabytes = 16;
+			iss >> megabytes;
+			if (table.open(path, megabytes)) {
+				printf("Transposition table mapped from %s\n\n", path.c_str());
+			}
+			continue;
+		}
+		if (token == "serve") {
+			std::string address;
+			if (!(iss >> address)) {
+				exit(-1);
+			}
+			int workers = std::max(1u, std::thread::hardware_concurrency());
+			size_t capacity = 1024;
+			iss >> workers >> capacity;
+			AnalysisServer server(&table, workers, capacity);
+			if (server.listen(address)) {
+				printf("Serving on %s with %d workers\n", address.c_str(), workers);
+				fflush(stdout);
+				server.run();
+				printf("Server stopped\n\n");
+			}
+			continue;
+		}
+		if (token == "datagen") {
+			std::string threads, nodes, positions, path;
+			if (!(iss >> threads >> nodes >> positions >> path)) {
+				exit(-1);
+			}
+			int threadCount;
+			unsigned long long nodeCount, positionCount;
+			try {
+				threadCount = std::stoi(threads);
+				nodeCount = std::stoull(nodes);
+				positionCount = std::stoull(positions);
+			}
+			catch (const std::exception&) {
+				printf("Usage: datagen <threads> <nodes> <positions> <file>\n\n");
+				continue;
+			}
+			if (threadCount < 1) {
+				printf("Datagen needs at least one thread\n\n");
+				continue;
+			}
+			DataGenerator generator(threadCount, nodeCount, positionCount);
+			generator.run(path);
+			continue;
+		}
+		if (token == "go") {
+			SearchLimits limits;
+			std::string name;
+			while (iss >> name) {
+				if (name == "infinite") {
+					limits.infinite = true;
+					continue;
+				}
+				if (name == "ponder") {
+					limits.ponder = true;
+					continue;
+				}
+				long long value;
+				if (!(iss >> value)) {
+					break;
+				}
+				if (name == "wtime") {
+					limits.time[0] = value;
+				}
+				if (name == "btime") {
+					limits.time[1] = value;
+				}
+				if (name == "winc") {
+					limits.increment[0] = value;
+				}
+				if (name == "binc") {
+					limits.increment[1] = value;
+				}
+				if (name == "movestogo") {
+					limits.movesToGo = value;
+				}
+				if (name == "movetime") {
+					limits.moveTime = value;
+				}
+				if (name == "depth") {
+					limits.depth = value;
+				}
+				if (name == "nodes") {
+					limits.nodes = value;
+				}
+				if (name == "multipv") {
+					limits.multiPV = value;
+				}
+			}
+			search.start(game, limits);
+			continue;
+		}
+		if (token == "hash") {
+			if (!std::getline(iss, token, ' ')) {
+				exit(-1);
+			}
+			table.resize(std::stoi(token));
+			continue;
+		}
+		if (token == "mate") {
+			if (!std::getline(iss, token, ' ')) {
+				exit(-1);
+			}
+			int moves = std::min(std::stoi(token), 32);
+			MateSearch mateSearch(64);
+			mateSearch.nodeLimit = 10000000; // about half a minute
+			std::string nodes;
+			if (std::getline(iss, nodes, ' ')) {
+				mateSearch.nodeLimit = std::stoull(nodes);
+			}
+			Move line[64];
+
+			clock_t start_time = clock();
+			int length = mateSearch.solve(game, moves, line);
+			if (length < 0) {
+				printf("Unknown: node limit reached before a mate in %d was found or ruled out\n", moves);
+			}
+			else if (length > 0) {
+				printf("Mate in %d:", (length + 1) / 2);
+				for (int i = 0; i < length; i++) {
+					char moveString[6];
+					game.moveToString(line[i], moveString);
+					printf(" %s", moveString);
+				}
+				printf("\n");
+			}
+			else {
+				printf("No mate in %s found\n", token.c_str());
+			}
+			clock_t end_time = clock();
+			double elapsed_time = (double)(end_time - start_time) / CLOCKS_PER_SEC;
+			printf("Nodes: %llu\nTime: %.3f\n\n", mateSearch.nodes, elapsed_time);
+			continue;
+		}
 		if (token == "eval") {
 			printf("Current position evaluation: %.2f\n\n", game.evaluatePosition());
 			continue;
@@ -0,0 +1,329 @@
+// Annotates the games of a PGN file with search evaluations and marks for inaccuracies, mistakes and blunders.
+// The main thread reads games and replays their SAN moves, a worker pool searches every position with one transposition
+// table shared per game, and a writer thread regenerates the SAN with the annotations and writes games in input order.
+// Usage: annotate <input.pgn> <output.pgn> [-threads <n>] [-nodes <n per position>] [-depth <n>] [-hash <megabytes per game>]
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../Board.h"
+#include "../Pgn.h"
+#include "../TranspositionTable.h"
+
+
+// Losses in pawns, from the mover's point of view, that earn a mark
+static const double INACCURACY = 0.5;
+static const double MISTAKE = 1.0;
+static const double BLUNDER = 2.0;
+static const double CLAMP = 10.0; // scores are capped here before comparing, so a missed mate in a won position isn't a blunder
+
+struct Game {
+	size_t index;
+	PgnGame pgn;
+	std::vector<Board> positions; // before each replayed move and after the last one
+	std::vector<Move> moves; // replayed moves; the moves of pgn after these could not be parsed
+	std::vector<double> scores; // [position]: search score for white
+	std::vector<double> played; // [position]: score for white of the move played from it, searched to the same horizon as scores
+	std::vector<Move> best; // [position]: best move found, if the position has a legal move
+	TranspositionTable table;
+	int remaining; // positions not searched yet
+
+	Game(size_t megabytes) : table(megabytes) {}
+};
+
+struct Task {
+	Game* game;
+	int position;
+};
+
+struct Pipeline {
+	int threads;
+	unsigned long long nodes;
+	int depth;
+	size_t window; // most games between reading and writing
+	FILE* output;
+
+	std::mutex mutex;
+	std::condition_variable taskReady; // workers wait for tasks
+	std::condition_variable gameDone; // the writer waits for the oldest game to finish
+	std::condition_variable windowFree; // the reader waits for room in the window
+	std::deque<std::unique_ptr<Game>> games; // in input order
+	std::deque<Task> tasks;
+	bool reading = true;
+
+	size_t written = 0;
+	size_t errors = 0;
+	unsigned long long positions = 0;
+	std::chrono::steady_clock::time_point start;
+};
+
+
+// Parse stage: replays the SAN moves of the game and keeps the position before each one
+static void replay(Game& game) {
+	Board position;
+	if (!position.parseFEN(game.pgn.startFEN()).ok()) {
+		return;
+	}
+	game.positions.push_back(position);
+	for (const PgnMove& pgnMove : game.pgn.moves) {
+		Move move;
+		if (!position.parseSAN(pgnMove.san, move)) {
+			break;
+		}
+		position.makeMove(&move);
+		game.moves.push_back(move);
+		game.positions.push_back(position);
+	}
+}
+
+// Score for white of a position without legal moves
+static double terminalScore(Board& position) {
+	bool mated = position.isInCheck(position.kingPosition[position.colorToMove == Piece::BLACK], 24 - position.colorToMove);
+	return !mated ? 0 : position.colorToMove == Piece::WHITE ? -1000 : 1000;
+}
+
+// Analysis stage: searches one position of a game into its scores; history holds the keys of the positions before it
+static void analyze(Pipeline& pipeline, Game& game, int index, PositionHistory& history) {
+	Board position = game.positions[index];
+	Move legal[256];
+	if (position.legalMoves(legal) == 0) {
+		game.scores[index] = terminalScore(position);
+		return;
+	}
+
+	// repetitions only look back to the last pawn move or capture
+	int first = std::max(0, index - std::min<int>(position.halfMoves, PositionHistory::CAPACITY / 2));
+	for (int i = first; i < index; i++) {
+		history.keys[i - first] = game.positions[i].hash;
+	}
+	position.history = &history;
+	position.historyLength = index - first;
+
+	SearchInfo info;
+	info.table = &game.table;
+	info.nodeLimit = pipeline.nodes;
+	position.searchInfo = &info;
+	Move bestMove;
+	game.scores[index] = position.iterativeDeepening(bestMove, pipeline.depth);
+	game.best[index] = bestMove;
+	if (index >= int(game.moves.size())) {
+		return;
+	}
+
+	// the played move one ply shallower, so that its score has the same horizon as the best move's: the search has no
+	// quiescence and scores of neighbouring depths swing too far to compare
+	int depth = info.completedDepth;
+	Board next = position;
+	next.makeMove(&game.moves[index]);
+	if (next.legalMoves(legal) == 0) {
+		game.played[index] = terminalScore(next);
+	}
+	else if (depth <= 1) {
+		game.played[index] = next.evaluatePosition();
+	}
+	else {
+		info.reset();
+		game.played[index] = next.iterativeDeepening(bestMove, depth - 1);
+	}
+}
+
+// Takes positions off the task queue until reading has finished and the queue is empty
+static void work(Pipeline* pipeline) {
+	PositionHistory history;
+	std::unique_lock<std::mutex> lock(pipeline->mutex);
+	while (true) {
+		pipeline->taskReady.wait(lock, [pipeline] { return !pipeline->tasks.empty() || !pipeline->reading; });
+		if (pipeline->tasks.empty()) {
+			break;
+		}
+		Task task = pipeline->tasks.front();
+		pipeline->tasks.pop_front();
+
+		lock.unlock();
+		analyze(*pipeline, *task.game, task.position, history);
+		lock.lock();
+		if (--task.game->remaining == 0) {
+			pipeline->gameDone.notify_one();
+		}
+	}
+}
+
+// Eval comment text for a score
+static std::string scoreText(double score) {
+	if (score >= 1000 || score <= -1000) {
+		return score > 0 ? "+mate" : "-mate";
+	}
+	char text[16];
+	snprintf(text, sizeof(text), "%+.2f", score);
+	return text;
+}
+
+// Output stage: regenerates the SAN of the replayed moves with evals and marks; unparsed moves are copied as they were
+static std::string annotate(Game& game) {
+	if (game.positions.empty()) {
+		return game.pgn.format();
+	}
+	PgnGame out = game.pgn;
+	out.setTag("Annotator", "ChessAI");
+	char san[8];
+	for (size_t i = 0; i < out.moves.size(); i++) {
+		PgnMove& move = out.moves[i];
+		if (i >= game.moves.size()) {
+			if (i == game.moves.size()) {
+				move.comment = "not a legal move";
+			}
+			continue;
+		}
+
+		Board& before = game.positions[i];
+		before.moveToSAN(game.moves[i], san);
+		move.san = san;
+		move.suffix.clear();
+		move.comment = scoreText(game.scores[i + 1]);
+
+		double loss = std::clamp(game.scores[i], -CLAMP, CLAMP) - std::clamp(game.played[i], -CLAMP, CLAMP);
+		if (before.colorToMove == Piece::BLACK) {
+			loss = -loss;
+		}
+		if (loss >= INACCURACY && !(game.best[i] == game.moves[i])) {
+			move.suffix = loss >= BLUNDER ? "??" : loss >= MISTAKE ? "?" : "?!";
+			if (game.best[i].from != game.best[i].to) {
+				before.moveToSAN(game.best[i], san);
+				move.comment += std::string("; best ") + san;
+			}
+		}
+	}
+	return out.format();
+}
+
+// Writes finished games in input order and reports the throughput every 100 games
+static void writeGames(Pipeline* pipeline) {
+	std::unique_lock<std::mutex> lock(pipeline->mutex);
+	while (true) {
+		pipeline->gameDone.wait(lock, [pipeline] {
+			return (!pipeline->games.empty() && pipeline->games.front()->remaining == 0) || (pipeline->games.empty() && !pipeline->reading);
+		});
+		if (pipeline->games.empty()) {
+			break;
+		}
+		std::unique_ptr<Game> game = std::move(pipeline->games.front());
+		pipeline->games.pop_front();
+		pipeline->windowFree.notify_one();
+
+		lock.unlock();
+		std::string text = annotate(*game);
+		fwrite(text.data(), 1, text.size(), pipeline->output);
+		bool error = game->positions.empty() || game->moves.size() < game->pgn.moves.size();
+		if (error) {
+			fprintf(stderr, "Game %zu: %s\n", game->index + 1, game->positions.empty() ? "invalid FEN tag"
+				: ("could not parse move " + game->pgn.moves[game->moves.size()].san).c_str());
+		}
+		lock.lock();
+
+		pipeline->written++;
+		pipeline->errors += error;
+		pipeline->positions += game->positions.size();
+		if (pipeline->written % 100 == 0) {
+			double minutes = std::chrono::duration<double>(std::chrono::steady_clock::now() - pipeline->start).count() / 60;
+			fprintf(stderr, "%zu games, %.1f games/min\n", pipeline->written, pipeline->written / minutes);
+		}
+	}
+}
+
+
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		printf("Usage: annotate <input.pgn> <output.pgn> [-threads <n>] [-nodes <n per position>] [-depth <n>] [-hash <megabytes per game>]\n");
+		return -1;
+	}
+	Pipeline pipeline;
+	pipeline.threads = std::max(1u, std::thread::hardware_concurrency());
+	pipeline.nodes = 100000;
+	pipeline.depth = 64;
+	size_t megabytes = 4;
+	for (int i = 3; i + 1 < argc; i += 2) {
+		if (std::strcmp(argv[i], "-threads") == 0) {
+			pipeline.threads = std::max(1, atoi(argv[i + 1]));
+		}
+		else if (std::strcmp(argv[i], "-nodes") == 0) {
+			pipeline.nodes = std::stoull(argv[i + 1]);
+		}
+		else if (std::strcmp(argv[i], "-depth") == 0) {
+			// a fixed depth replaces the default node limit
+			pipeline.depth = std::max(1, atoi(argv[i + 1]));
+			pipeline.nodes = 0;
+		}
+		else if (std::strcmp(argv[i], "-hash") == 0) {
+			megabytes = std::max(1, atoi(argv[i + 1]));
+		}
+	}
+	pipeline.window = pipeline.threads * 2;
+
+	FILE* input = fopen(argv[1], "rb");
+	if (input == nullptr) {
+		printf("Could not open %s\n", argv[1]);
+		return -1;
+	}
+	pipeline.output = fopen(argv[2], "wb");
+	if (pipeline.output == nullptr) {
+		printf("Could not create %s\n", argv[2]);
+		return -1;
+	}
+
+	pipeline.start = std::chrono::steady_clock::now();
+	std::vector<std::thread> workers;
+	for (int i = 0; i < pipeline.threads; i++) {
+		workers.emplace_back(work, &pipeline);
+	}
+	std::thread writer(writeGames, &pipeline);
+
+	// parse stage on this thread; games wait for room in the window so memory stays bounded on large files
+	PgnReader reader(input);
+	for (size_t index = 0; ; index++) {
+		std::unique_ptr<Game> game(new Game(megabytes));
+		if (!reader.next(game->pgn)) {
+			break;
+		}
+		game->index = index;
+		replay(*game);
+		game->scores.resize(game->positions.size());
+		game->played.resize(game->positions.size());
+		game->best.resize(game->positions.size());
+		game->remaining = game->positions.size();
+
+		std::unique_lock<std::mutex> lock(pipeline.mutex);
+		pipeline.windowFree.wait(lock, [&pipeline] { return pipeline.games.size() < pipeline.window; });
+		for (size_t i = 0; i < game->positions.size(); i++) {
+			pipeline.tasks.push_back({ game.get(), int(i) });
+		}
+		pipeline.games.push_back(std::move(game));
+		pipeline.taskReady.notify_all();
+		pipeline.gameDone.notify_one();
+	}
+	{
+		std::lock_guard<std::mutex> lock(pipeline.mutex);
+		pipeline.reading = false;
+	}
+	pipeline.taskReady.notify_all();
+	pipeline.gameDone.notify_one();
+
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+	writer.join();
+	fclose(input);
+	fclose(pipeline.output);
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - pipeline.start).count();
+	printf("Games: %zu (%zu with errors), positions: %llu in %.1f s\n", pipeline.written, pipeline.errors, pipeline.positions, seconds);
+	printf("Throughput: %.1f games/min, %.0f positions/s on %d threads\n",
+		pipeline.written * 60 / seconds, pipeline.positions / seconds, pipeline.threads);
+	return 0;
+}
@@ -0,0 +1,170 @@
+// Compares the attack lookup of isInCheck with the ray scan of isInCheckScan, then times perft and a fixed-depth search.
+// Built as attackbench-maps, isInCheck reads the incrementally kept attack maps; run both builds to compare them.
+// Usage: attackbench [fen file] [iterations] [perft depth] [search depth]
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "../Board.h"
+#include "../TranspositionTable.h"
+
+
+// Times fn over every position and returns ns per call; calls counts the calls of one pass
+template <typename Fn>
+static double timeCalls(std::vector<Board>& positions, int iterations, long long calls, Fn fn) {
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++) {
+		for (Board& position : positions) {
+			fn(position);
+		}
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return seconds * 1e9 / (double(iterations) * calls);
+}
+
+#ifdef ATTACK_MAPS
+// Walks the move tree to depth and counts the positions whose attack maps differ from ones computed from scratch
+static long long verifyMaps(Board& position, int depth) {
+	Board fresh = position;
+	fresh.computeAttackCounts();
+	long long mismatches = std::memcmp(fresh.attackCounts, position.attackCounts, sizeof(fresh.attackCounts)) != 0;
+	if (depth == 0) {
+		return mismatches;
+	}
+	MoveList moves = position.GenerateMoves();
+	Move* currentMove;
+	while ((currentMove = moves.pop_front()) != nullptr) {
+		Board next = position;
+		if (next.makeMove(currentMove)) {
+			mismatches += verifyMaps(next, depth - 1);
+		}
+	}
+	return mismatches;
+}
+#endif
+
+
+int main(int argc, char** argv) {
+	std::vector<std::string> fens = {
+		"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+		"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+		"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+		"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+		"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+		"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10"
+	};
+	if (argc > 1) {
+		std::ifstream in(argv[1]);
+		if (!in) {
+			printf("Could not open %s\n", argv[1]);
+			return -1;
+		}
+		fens.clear();
+		std::string line;
+		while (std::getline(in, line)) {
+			if (!line.empty()) {
+				fens.push_back(line);
+			}
+		}
+	}
+
+	std::vector<Board> positions;
+	for (const std::string& fen : fens) {
+		Board position;
+		if (position.parseFEN(fen).ok()) {
+			positions.push_back(position);
+		}
+	}
+	if (positions.empty()) {
+		printf("No valid positions\n");
+		return -1;
+	}
+	int iterations = argc > 2 ? std::stoi(argv[2]) : 200000 / positions.size() + 1;
+	int perftDepth = argc > 3 ? std::stoi(argv[3]) : 4;
+	int searchDepth = argc > 4 ? std::stoi(argv[4]) : 5;
+#ifdef ATTACK_MAPS
+	printf("isInCheck: incremental attack maps (Board is %zu bytes)\n", sizeof(Board));
+#else
+	printf("isInCheck: piece-list lookup (Board is %zu bytes)\n", sizeof(Board));
+#endif
+
+	// both versions must agree on every square for both colors
+	long long mismatches = 0;
+	for (Board& position : positions) {
+		for (int square = 0; square < 128; square++) {
+			if (!position.isSquareValid(square)) {
+				continue;
+			}
+			for (unsigned char color : { Piece::WHITE, Piece::BLACK }) {
+				mismatches += position.isInCheck(square, color) != position.isInCheckScan(square, color);
+			}
+		}
+	}
+	printf("Positions: %zu, mismatches: %lld\n", positions.size(), mismatches);
+#ifdef ATTACK_MAPS
+	long long mapMismatches = 0;
+	for (Board& position : positions) {
+		mapMismatches += verifyMaps(position, 3);
+	}
+	printf("Attack maps differing from a recomputation within 3 plies: %lld\n", mapMismatches);
+#endif
+
+	// every square, as in castling checks
+	volatile int sink = 0;
+	long long calls = positions.size() * 128LL;
+	double tableAll = timeCalls(positions, iterations / 16 + 1, calls, [&](Board& position) {
+		for (int square = 0; square < 128; square++) {
+			if (position.isSquareValid(square)) {
+				sink += position.isInCheck(square, Piece::WHITE) + position.isInCheck(square, Piece::BLACK);
+			}
+		}
+	});
+	double scanAll = timeCalls(positions, iterations / 16 + 1, calls, [&](Board& position) {
+		for (int square = 0; square < 128; square++) {
+			if (position.isSquareValid(square)) {
+				sink += position.isInCheckScan(square, Piece::WHITE) + position.isInCheckScan(square, Piece::BLACK);
+			}
+		}
+	});
+
+	// king squares, as in the legality check of makeMove
+	calls = positions.size() * 2LL;
+	double tableKing = timeCalls(positions, iterations, calls, [&](Board& position) {
+		sink += position.isInCheck(position.kingPosition[0], Piece::BLACK) + position.isInCheck(position.kingPosition[1], Piece::WHITE);
+	});
+	double scanKing = timeCalls(positions, iterations, calls, [&](Board& position) {
+		sink += position.isInCheckScan(position.kingPosition[0], Piece::BLACK) + position.isInCheckScan(position.kingPosition[1], Piece::WHITE);
+	});
+
+	printf("All squares:  tables %.2f ns/call, ray scan %.2f ns/call (%.2fx)\n", tableAll, scanAll, scanAll / tableAll);
+	printf("King squares: tables %.2f ns/call, ray scan %.2f ns/call (%.2fx)\n", tableKing, scanKing, scanKing / tableKing);
+
+	// whole-engine cost: every move made pays for the map updates, every legality check gains from them
+	unsigned long long nodes = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (Board& position : positions) {
+		position.depth = 0; // no per-move output
+		nodes += position.perft(perftDepth);
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("Perft %d: %llu nodes in %.3f s (%.2f M nodes/s)\n", perftDepth, nodes, seconds, nodes / seconds / 1e6);
+
+	TranspositionTable table(16);
+	nodes = 0;
+	start = std::chrono::steady_clock::now();
+	for (Board& position : positions) {
+		SearchInfo info;
+		info.table = &table;
+		position.searchInfo = &info;
+		table.clear();
+		table.newSearch();
+		Move bestMove;
+		position.iterativeDeepening(bestMove, searchDepth);
+		nodes += info.nodes;
+	}
+	seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("Search depth %d: %llu nodes in %.3f s (%.2f M nodes/s)\n", searchDepth, nodes, seconds, nodes / seconds / 1e6);
+	return 0;
+}
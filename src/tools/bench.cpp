@@ -0,0 +1,235 @@
+// Microbenchmark of the core Board primitives over a position corpus, in ns per operation
+// Usage:
+//	bench [-corpus <fen file>] [-positions <n>] [-repetitions <n>] [-json]
+//	bench compare <before.csv> <after.csv>
+// Without a corpus, positions come from seeded random games so two builds measure the same set.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../Board.h"
+
+
+// Positions with their FEN and legal moves precomputed
+struct Corpus {
+	std::vector<Board> positions;
+	std::vector<std::string> fens;
+	std::vector<std::vector<Move>> moves;
+};
+
+struct Result {
+	const char* name;
+	long long operations; // per repetition
+	std::vector<double> nanoseconds; // per operation, one value per repetition
+};
+
+
+// Plays seeded random games from the start position and keeps every position with a legal move
+static void randomCorpus(Corpus& corpus, int count) {
+	std::mt19937 random(12345);
+	while (int(corpus.fens.size()) < count) {
+		Board game;
+		game.loadPosition("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+		for (int ply = 0; ply < 120 && int(corpus.fens.size()) < count; ply++) {
+			Move legal[218];
+			int legalCount = game.legalMoves(legal);
+			if (legalCount == 0) {
+				break;
+			}
+			corpus.fens.push_back(game.toFEN());
+			game.makeMove(&legal[random() % legalCount]);
+		}
+	}
+}
+
+static bool loadCorpus(Corpus& corpus, const char* path, int count) {
+	std::ifstream in(path);
+	if (!in) {
+		printf("Could not open %s\n", path);
+		return false;
+	}
+	std::string line;
+	Board position;
+	while (std::getline(in, line) && int(corpus.fens.size()) < count) {
+		if (!line.empty() && position.parseFEN(line).ok()) {
+			corpus.fens.push_back(line);
+		}
+	}
+	return !corpus.fens.empty();
+}
+
+// Times one pass of fn per repetition after an untimed warm-up pass
+template <typename Fn>
+static Result measure(const char* name, long long operations, int repetitions, Fn fn) {
+	Result result = { name, operations, {} };
+	fn();
+	for (int r = 0; r < repetitions; r++) {
+		auto start = std::chrono::steady_clock::now();
+		fn();
+		double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+		result.nanoseconds.push_back(elapsed / operations);
+	}
+	return result;
+}
+
+
+// Compares two CSV outputs of bench by primitive
+static int compare(const char* beforePath, const char* afterPath) {
+	auto read = [](const char* path, std::map<std::string, double>& medians) {
+		std::ifstream in(path);
+		std::string line;
+		std::getline(in, line); // header
+		while (std::getline(in, line)) {
+			std::stringstream fields(line);
+			std::string name, value;
+			std::vector<std::string> values;
+			std::getline(fields, name, ',');
+			while (std::getline(fields, value, ',')) {
+				values.push_back(value);
+			}
+			if (values.size() >= 5) {
+				medians[name] = std::stod(values[4]);
+			}
+		}
+		return !medians.empty();
+	};
+	std::map<std::string, double> before, after;
+	if (!read(beforePath, before) || !read(afterPath, after)) {
+		printf("Could not read both files\n");
+		return -1;
+	}
+	printf("primitive,before_median_ns,after_median_ns,speedup\n");
+	for (auto& entry : before) {
+		if (after.count(entry.first)) {
+			printf("%s,%.2f,%.2f,%.3f\n", entry.first.c_str(), entry.second, after[entry.first], entry.second / after[entry.first]);
+		}
+	}
+	return 0;
+}
+
+
+int main(int argc, char** argv) {
+	if (argc == 4 && std::strcmp(argv[1], "compare") == 0) {
+		return compare(argv[2], argv[3]);
+	}
+
+	const char* corpusPath = nullptr;
+	int count = 4000, repetitions = 10;
+	bool json = false;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "-corpus") == 0 && i + 1 < argc) {
+			corpusPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "-positions") == 0 && i + 1 < argc) {
+			count = std::max(1, std::stoi(argv[++i]));
+		}
+		else if (std::strcmp(argv[i], "-repetitions") == 0 && i + 1 < argc) {
+			repetitions = std::max(2, std::stoi(argv[++i]));
+		}
+		else if (std::strcmp(argv[i], "-json") == 0) {
+			json = true;
+		}
+		else {
+			printf("Usage:\n\tbench [-corpus <fen file>] [-positions <n>] [-repetitions <n>] [-json]\n\tbench compare <before.csv> <after.csv>\n");
+			return -1;
+		}
+	}
+
+	Corpus corpus;
+	if (corpusPath != nullptr) {
+		if (!loadCorpus(corpus, corpusPath, count)) {
+			return -1;
+		}
+	}
+	else {
+		randomCorpus(corpus, count);
+	}
+	long long moveCount = 0;
+	for (const std::string& fen : corpus.fens) {
+		Board position;
+		position.parseFEN(fen);
+		corpus.positions.push_back(position);
+		Move legal[218];
+		corpus.moves.emplace_back(legal, legal + position.legalMoves(legal));
+		moveCount += corpus.moves.back().size();
+	}
+	long long positionCount = corpus.positions.size();
+
+	volatile long long sink = 0;
+	std::vector<Result> results;
+	results.push_back(measure("GenerateMoves", positionCount, repetitions, [&]() {
+		for (Board& position : corpus.positions) {
+			sink += position.GenerateMoves().size;
+		}
+	}));
+	results.push_back(measure("makeMove", moveCount, repetitions, [&]() {
+		for (size_t i = 0; i < corpus.positions.size(); i++) {
+			Board& position = corpus.positions[i];
+			Board saved = position;
+			for (Move& move : corpus.moves[i]) {
+				sink += position.makeMove(&move);
+				position = saved;
+			}
+		}
+	}));
+	// a single pass of the cheap primitive is too short to time reliably
+	results.push_back(measure("isInCheck", positionCount * 16, repetitions, [&]() {
+		for (int pass = 0; pass < 16; pass++) {
+			for (Board& position : corpus.positions) {
+				unsigned char king = position.kingPosition[position.colorToMove == Piece::BLACK];
+				sink += position.isInCheck(king, 24 - position.colorToMove);
+			}
+		}
+	}));
+	results.push_back(measure("evaluatePosition", positionCount, repetitions, [&]() {
+		for (Board& position : corpus.positions) {
+			sink += (long long)position.evaluatePosition();
+		}
+	}));
+	results.push_back(measure("loadPosition", positionCount, repetitions, [&]() {
+		Board position;
+		for (const std::string& fen : corpus.fens) {
+			sink += position.loadPosition(fen);
+		}
+	}));
+
+	if (json) {
+		printf("{\"positions\": %lld, \"moves\": %lld, \"repetitions\": %d, \"results\": [\n", positionCount, moveCount, repetitions);
+	}
+	else {
+		printf("primitive,operations,mean_ns,stddev_ns,cv_percent,median_ns,min_ns,max_ns\n");
+	}
+	for (size_t i = 0; i < results.size(); i++) {
+		std::vector<double> values = results[i].nanoseconds;
+		std::sort(values.begin(), values.end());
+		double mean = 0, variance = 0;
+		for (double value : values) {
+			mean += value;
+		}
+		mean /= values.size();
+		for (double value : values) {
+			variance += (value - mean) * (value - mean);
+		}
+		double stddev = std::sqrt(variance / (values.size() - 1));
+		double median = values.size() % 2 ? values[values.size() / 2] : (values[values.size() / 2 - 1] + values[values.size() / 2]) / 2;
+		if (json) {
+			printf("\t{\"primitive\": \"%s\", \"operations\": %lld, \"mean_ns\": %.3f, \"stddev_ns\": %.3f, \"cv_percent\": %.2f, \"median_ns\": %.3f, \"min_ns\": %.3f, \"max_ns\": %.3f}%s\n",
+				results[i].name, results[i].operations, mean, stddev, stddev * 100 / mean, median, values.front(), values.back(), i + 1 < results.size() ? "," : "");
+		}
+		else {
+			printf("%s,%lld,%.3f,%.3f,%.2f,%.3f,%.3f,%.3f\n",
+				results[i].name, results[i].operations, mean, stddev, stddev * 100 / mean, median, values.front(), values.back());
+		}
+	}
+	if (json) {
+		printf("]}\n");
+	}
+	return 0;
+}
@@ -0,0 +1,144 @@
+// Throughput of the batch evaluator against calling evaluatePosition on each board, with a bit-identity check
+// Usage: evalbench [-corpus <fen file>] [-positions <n>] [-batch <n>] [-repetitions <n>]
+// Without a corpus, positions come from seeded random games.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include "../BatchEval.h"
+#include "../Board.h"
+
+
+// Plays seeded random games from the start position and keeps every position reached
+static void randomPositions(std::vector<Board>& positions, size_t count) {
+	std::mt19937 random(12345);
+	while (positions.size() < count) {
+		Board game;
+		game.loadPosition("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+		for (int ply = 0; ply < 160 && positions.size() < count; ply++) {
+			std::vector<Move> legal;
+			MoveList moves = game.GenerateMoves();
+			Move* currentMove;
+			while ((currentMove = moves.pop_front()) != nullptr) {
+				Board next = game;
+				if (next.makeMove(currentMove)) {
+					legal.push_back(*currentMove);
+				}
+			}
+			if (legal.empty()) {
+				break;
+			}
+			game.makeMove(&legal[random() % legal.size()]);
+			positions.push_back(game);
+		}
+	}
+}
+
+// Returns the best time in seconds of repetitions runs of fn
+template <typename Fn>
+static double best(int repetitions, Fn fn) {
+	double fastest = 1e30;
+	for (int r = 0; r < repetitions; r++) {
+		auto start = std::chrono::steady_clock::now();
+		fn();
+		fastest = std::min(fastest, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+	return fastest;
+}
+
+
+int main(int argc, char** argv) {
+	const char* corpusPath = nullptr;
+	size_t count = 200000, batchSize = 4096;
+	int repetitions = 5;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "-corpus") == 0 && i + 1 < argc) {
+			corpusPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "-positions") == 0 && i + 1 < argc) {
+			count = std::max(1, std::stoi(argv[++i]));
+		}
+		else if (std::strcmp(argv[i], "-batch") == 0 && i + 1 < argc) {
+			batchSize = std::max(1, std::stoi(argv[++i]));
+		}
+		else if (std::strcmp(argv[i], "-repetitions") == 0 && i + 1 < argc) {
+			repetitions = std::max(1, std::stoi(argv[++i]));
+		}
+		else {
+			printf("Usage: evalbench [-corpus <fen file>] [-positions <n>] [-batch <n>] [-repetitions <n>]\n");
+			return -1;
+		}
+	}
+
+	std::vector<Board> positions;
+	if (corpusPath != nullptr) {
+		std::ifstream in(corpusPath);
+		std::string line;
+		Board position;
+		while (std::getline(in, line) && positions.size() < count) {
+			if (!line.empty() && position.parseFEN(line).ok()) {
+				positions.push_back(position);
+			}
+		}
+		if (positions.empty()) {
+			printf("No positions in %s\n", corpusPath);
+			return -1;
+		}
+	}
+	else {
+		randomPositions(positions, count);
+	}
+
+	// the whole corpus is converted once, batch by batch, so the kernels are timed on their own
+	std::vector<PositionBatch> batches;
+	double fillSeconds = best(1, [&]() {
+		for (size_t i = 0; i < positions.size(); i++) {
+			if (batches.empty() || !batches.back().add(positions[i])) {
+				batches.emplace_back(batchSize);
+				batches.back().add(positions[i]);
+			}
+		}
+	});
+
+	std::vector<double> expected(positions.size()), scalar(positions.size()), simd(positions.size());
+	double boardSeconds = best(repetitions, [&]() {
+		for (size_t i = 0; i < positions.size(); i++) {
+			expected[i] = positions[i].evaluatePosition();
+		}
+	});
+	auto runBatches = [&](std::vector<double>& scores, void (*kernel)(const PositionBatch&, double*)) {
+		size_t offset = 0;
+		for (const PositionBatch& batch : batches) {
+			kernel(batch, &scores[offset]);
+			offset += batch.size;
+		}
+	};
+	double scalarSeconds = best(repetitions, [&]() { runBatches(scalar, BatchEval::evaluateScalar); });
+	double simdSeconds = 0;
+	if (BatchEval::hasAvx2()) {
+		simdSeconds = best(repetitions, [&]() { runBatches(simd, BatchEval::evaluateAvx2); });
+	}
+
+	size_t scalarMismatches = 0, simdMismatches = 0;
+	for (size_t i = 0; i < positions.size(); i++) {
+		scalarMismatches += std::memcmp(&expected[i], &scalar[i], sizeof(double)) != 0;
+		simdMismatches += simdSeconds > 0 && std::memcmp(&expected[i], &simd[i], sizeof(double)) != 0;
+	}
+
+	double n = positions.size();
+	printf("Positions: %zu in batches of %zu\n", positions.size(), batchSize);
+	printf("evaluatePosition: %.2f M positions/s\n", n / boardSeconds / 1e6);
+	printf("batch fill: %.2f M positions/s\n", n / fillSeconds / 1e6);
+	printf("batch scalar: %.2f M positions/s (%.2fx), %zu mismatches\n", n / scalarSeconds / 1e6, boardSeconds / scalarSeconds, scalarMismatches);
+	if (simdSeconds > 0) {
+		printf("batch AVX2: %.2f M positions/s (%.2fx), %zu mismatches\n", n / simdSeconds / 1e6, boardSeconds / simdSeconds, simdMismatches);
+	}
+	else {
+		printf("batch AVX2: not available\n");
+	}
+	return scalarMismatches + simdMismatches > 0 ? 1 : 0;
+}
@@ -0,0 +1,67 @@
+// FEN parse/serialize throughput microbenchmark
+// Usage: fenbench [fen or epd file] [iterations]
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "../Board.h"
+
+
+int main(int argc, char** argv) {
+	std::vector<std::string> fens = {
+		"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+		"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+		"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+		"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+		"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+		"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10"
+	};
+	if (argc > 1) {
+		std::ifstream in(argv[1]);
+		if (!in) {
+			printf("Could not open %s\n", argv[1]);
+			return -1;
+		}
+		fens.clear();
+		std::string line;
+		while (std::getline(in, line)) {
+			if (!line.empty()) {
+				fens.push_back(line);
+			}
+		}
+	}
+	int iterations = argc > 2 ? std::stoi(argv[2]) : 200000 / fens.size() + 1;
+
+	size_t bytes = 0;
+	for (const std::string& fen : fens) {
+		bytes += fen.size();
+	}
+
+	Board position;
+	EpdOperations operations;
+	size_t errors = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++) {
+		for (const std::string& fen : fens) {
+			errors += !position.parseFEN(fen, &operations).ok();
+		}
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	double count = double(iterations) * fens.size();
+	printf("parseFEN: %.1f ns/op, %.0f positions/s, %.1f MB/s (%zu errors)\n",
+		seconds * 1e9 / count, count / seconds, bytes * double(iterations) / seconds / 1e6, errors / iterations);
+
+	char buffer[96];
+	size_t written = 0;
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++) {
+		for (const std::string& fen : fens) {
+			position.parseFEN(fen);
+			written += position.writeFEN(buffer);
+		}
+	}
+	double roundTrip = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("writeFEN: %.1f ns/op (%zu bytes)\n", (roundTrip - seconds) * 1e9 / count, written);
+	return 0;
+}
@@ -0,0 +1,157 @@
+// Load generator for the analysis server: each connection keeps one request in flight
+// Usage: loadgen <unix:path | tcp:port> <requests> <connections> <movetime ms> [fen file]
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+// Opens a connection to the server; returns -1 on failure
+static int connectTo(const std::string& address) {
+	if (address.compare(0, 5, "unix:") == 0) {
+		sockaddr_un name;
+		std::memset(&name, 0, sizeof(name));
+		name.sun_family = AF_UNIX;
+		std::strncpy(name.sun_path, address.c_str() + 5, sizeof(name.sun_path) - 1);
+		int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd >= 0 && connect(fd, (sockaddr*)&name, sizeof(name)) == 0) {
+			return fd;
+		}
+		close(fd);
+		return -1;
+	}
+	if (address.compare(0, 4, "tcp:") == 0) {
+		sockaddr_in name;
+		std::memset(&name, 0, sizeof(name));
+		name.sin_family = AF_INET;
+		name.sin_port = htons(atoi(address.c_str() + 4));
+		name.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		int fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (fd >= 0 && connect(fd, (sockaddr*)&name, sizeof(name)) == 0) {
+			return fd;
+		}
+		close(fd);
+		return -1;
+	}
+	return -1;
+}
+
+// Sends requests until the shared counter runs out, recording each round trip in microseconds
+static void client(const std::string& address, const std::vector<std::string>& fens, int movetime,
+	std::atomic<int>* remaining, std::vector<long long>* latencies, std::atomic<int>* errors) {
+	int fd = connectTo(address);
+	if (fd < 0) {
+		printf("Could not connect to %s\n", address.c_str());
+		return;
+	}
+
+	std::string buffer;
+	char chunk[4096];
+	int request;
+	while ((request = --*remaining) >= 0) {
+		char line[256];
+		int length = snprintf(line, sizeof(line), "{\"id\": %d, \"fen\": \"%s\", \"movetime\": %d}\n",
+			request, fens[request % fens.size()].c_str(), movetime);
+
+		auto start = std::chrono::steady_clock::now();
+		if (send(fd, line, length, MSG_NOSIGNAL) != length) {
+			break;
+		}
+		size_t end;
+		while ((end = buffer.find('\n')) == std::string::npos) {
+			ssize_t received = recv(fd, chunk, sizeof(chunk), 0);
+			if (received <= 0) {
+				close(fd);
+				return;
+			}
+			buffer.append(chunk, received);
+		}
+		auto elapsed = std::chrono::steady_clock::now() - start;
+
+		if (buffer.substr(0, end).find("\"error\"") != std::string::npos) {
+			++*errors;
+		}
+		else {
+			latencies->push_back(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+		}
+		buffer.erase(0, end + 1);
+	}
+	close(fd);
+}
+
+
+int main(int argc, char** argv) {
+	if (argc < 5) {
+		printf("Usage: loadgen <unix:path | tcp:port> <requests> <connections> <movetime ms> [fen file]\n");
+		return -1;
+	}
+	std::string address = argv[1];
+	int requests = std::stoi(argv[2]);
+	int connections = std::max(1, std::stoi(argv[3]));
+	int movetime = std::stoi(argv[4]);
+
+	std::vector<std::string> fens = {
+		"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+		"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+		"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+		"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+		"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+		"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10"
+	};
+	if (argc > 5) {
+		std::ifstream in(argv[5]);
+		if (!in) {
+			printf("Could not open %s\n", argv[5]);
+			return -1;
+		}
+		fens.clear();
+		std::string line;
+		while (std::getline(in, line)) {
+			if (!line.empty() && line.size() < 128 && line.find('"') == std::string::npos) {
+				fens.push_back(line);
+			}
+		}
+		if (fens.empty()) {
+			printf("No positions in %s\n", argv[5]);
+			return -1;
+		}
+	}
+
+	std::atomic<int> remaining(requests), errors(0);
+	std::vector<std::vector<long long>> latencies(connections);
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> clients;
+	for (int i = 0; i < connections; i++) {
+		clients.emplace_back(client, address, std::cref(fens), movetime, &remaining, &latencies[i], &errors);
+	}
+	for (std::thread& thread : clients) {
+		thread.join();
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::vector<long long> all;
+	for (const std::vector<long long>& part : latencies) {
+		all.insert(all.end(), part.begin(), part.end());
+	}
+	if (all.empty()) {
+		printf("No replies (%d errors)\n", errors.load());
+		return -1;
+	}
+	std::sort(all.begin(), all.end());
+	auto percentile = [&all](double p) {
+		return all[std::min(all.size() - 1, size_t(p * all.size()))] / 1000.0;
+	};
+	printf("Replies: %zu, errors: %d, %.1f requests/s\n", all.size(), errors.load(), all.size() / seconds);
+	printf("Latency ms: p50 %.2f, p90 %.2f, p99 %.2f, max %.2f\n", percentile(0.5), percentile(0.9), percentile(0.99), all.back() / 1000.0);
+	return 0;
+}
@@ -0,0 +1,373 @@
+// Engine-vs-engine match runner: plays two ChessAI builds against each other as child processes, several games at a time,
+// adjudicates with the move generator and reports Elo with a 95% interval and a running SPRT verdict.
+// Every opening is played twice with colors reversed.
+// Usage: match <engine A> <engine B> [-games n] [-concurrency n] [-movetime ms] [-openings file] [-elo0 x] [-elo1 x] [-alpha x] [-beta x]
+// Exit code: 0 if the SPRT accepts that A is stronger by elo1, 1 if it accepts elo0, 2 if the games ran out first.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "../Board.h"
+
+
+// A ChessAI child process driven through its command line interface
+class Engine {
+public:
+	Engine(const std::string& path) : path(path) {
+		start();
+	}
+
+	~Engine() {
+		quit();
+	}
+
+	bool running() {
+		return pid > 0;
+	}
+
+	bool send(const std::string& text) {
+		return write(input, text.data(), text.size()) == ssize_t(text.size());
+	}
+
+	// Reads lines until one starts with "bestmove"; returns its move, or an empty string on timeout or exit
+	std::string bestMove(int timeoutMs) {
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+		while (true) {
+			size_t end;
+			while ((end = buffer.find('\n')) != std::string::npos) {
+				// the prompt ">>" is printed without a newline, so it can precede any line
+				std::string line = buffer.substr(0, end);
+				buffer.erase(0, end + 1);
+				size_t start = line.find_first_not_of('>');
+				if (start != std::string::npos && line.compare(start, 9, "bestmove ") == 0) {
+					std::string move = line.substr(start + 9);
+					return move.substr(0, move.find(' '));
+				}
+			}
+
+			int left = int(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count());
+			pollfd readable = { output, POLLIN, 0 };
+			if (left <= 0 || poll(&readable, 1, left) <= 0) {
+				return "";
+			}
+			char chunk[4096];
+			ssize_t received = read(output, chunk, sizeof(chunk));
+			if (received <= 0) {
+				return "";
+			}
+			buffer.append(chunk, received);
+		}
+	}
+
+	// Brings an engine that didn't answer in time back in step: stops its search and drops the late bestmove, so it isn't
+	// read as the reply to the next position. An engine that doesn't answer the stop either is restarted
+	void resync(int timeoutMs) {
+		if (!send("stop\n") || bestMove(timeoutMs).empty()) {
+			quit();
+			start();
+		}
+		buffer.clear();
+	}
+
+private:
+	std::string path;
+	pid_t pid;
+	int input, output;
+	std::string buffer;
+
+	void start() {
+		pid = -1;
+		int toChild[2], fromChild[2];
+		if (pipe(toChild) < 0 || pipe(fromChild) < 0) {
+			return;
+		}
+		pid = fork();
+		if (pid == 0) {
+			dup2(toChild[0], STDIN_FILENO);
+			dup2(fromChild[1], STDOUT_FILENO);
+			close(toChild[0]);
+			close(toChild[1]);
+			close(fromChild[0]);
+			close(fromChild[1]);
+			execl(path.c_str(), path.c_str(), (char*)nullptr);
+			_exit(127);
+		}
+		close(toChild[0]);
+		close(fromChild[1]);
+		input = toChild[1];
+		output = fromChild[0];
+	}
+
+	void quit() {
+		if (pid <= 0) {
+			return;
+		}
+		send("exit\n");
+		close(input);
+		close(output);
+		// give it a moment to exit on its own before killing it
+		for (int i = 0; i < 50 && waitpid(pid, nullptr, WNOHANG) == 0; i++) {
+			usleep(10000);
+		}
+		if (waitpid(pid, nullptr, WNOHANG) == 0) {
+			kill(pid, SIGKILL);
+			waitpid(pid, nullptr, 0);
+		}
+		pid = -1;
+		buffer.clear();
+	}
+};
+
+
+// Wins, draws and losses of engine A
+struct Score {
+	int wins = 0, draws = 0, losses = 0;
+
+	int games() const {
+		return wins + draws + losses;
+	}
+};
+
+// Expected score for an Elo difference
+static double expectedScore(double elo) {
+	return 1 / (1 + std::pow(10.0, -elo / 400));
+}
+
+static double eloFromScore(double score) {
+	score = std::min(std::max(score, 1e-6), 1 - 1e-6);
+	return -400 * std::log10(1 / score - 1);
+}
+
+// Mean score and its per-game variance
+static void scoreStatistics(const Score& score, double& mean, double& variance) {
+	double n = score.games();
+	mean = (score.wins + 0.5 * score.draws) / n;
+	variance = (score.wins * std::pow(1 - mean, 2) + score.draws * std::pow(0.5 - mean, 2) + score.losses * std::pow(mean, 2)) / n;
+}
+
+// Log-likelihood ratio of elo1 against elo0 under the normal approximation of the trinomial model
+static double logLikelihoodRatio(const Score& score, double elo0, double elo1) {
+	if (score.games() == 0) {
+		return 0;
+	}
+	double mean, variance;
+	scoreStatistics(score, mean, variance);
+	if (variance == 0) {
+		return 0; // every game had the same result; there is nothing to scale the difference by yet
+	}
+	double s0 = expectedScore(elo0), s1 = expectedScore(elo1);
+	return score.games() * (s1 - s0) * (2 * mean - s0 - s1) / (2 * variance);
+}
+
+
+// Neither side can mate: bare kings, or a single minor piece against a bare king
+static bool insufficientMaterial(const Board& position) {
+	int minors = 0;
+	for (int i = 0; i < 128; i++) {
+		if (i & 0x88) {
+			continue;
+		}
+		unsigned char type = position.board[i] & 0x07;
+		if (type == Piece::PAWN || type == Piece::ROOK || type == Piece::QUEEN) {
+			return false;
+		}
+		if (type == Piece::KNIGHT || type == Piece::BISHOP) {
+			minors++;
+		}
+	}
+	return minors <= 1;
+}
+
+// Plays one game; returns the result for white: 1, 0.5 or 0
+static double playGame(Engine& white, Engine& black, const std::string& opening, int movetime, int maxPlies) {
+	PositionHistory history;
+	Board game;
+	game.history = &history;
+	if (!game.parseFEN(opening).ok()) {
+		return 0.5;
+	}
+
+	std::string moves;
+	Move legal[218];
+	for (int ply = 0; ply < maxPlies; ply++) {
+		int count = game.legalMoves(legal);
+		if (count == 0) {
+			unsigned char kingPos = game.kingPosition[game.colorToMove == Piece::BLACK];
+			if (game.isInCheck(kingPos, 24 - game.colorToMove)) {
+				return game.colorToMove == Piece::WHITE ? 0 : 1;
+			}
+			return 0.5;
+		}
+		if (game.halfMoves >= 100 || game.repetitions() >= 2 || insufficientMaterial(game)) {
+			return 0.5;
+		}
+
+		// replaying the game keeps the engine's repetition history right
+		Engine& engine = game.colorToMove == Piece::WHITE ? white : black;
+		double loss = game.colorToMove == Piece::WHITE ? 0 : 1;
+		engine.send("load fen " + opening + "\n" + moves + "go movetime " + std::to_string(movetime) + "\n");
+		std::string reply = engine.bestMove(movetime + 2000);
+
+		// no answer in time or an illegal move loses
+		int chosen = -1;
+		char moveString[6];
+		for (int i = 0; i < count && chosen < 0; i++) {
+			game.moveToString(legal[i], moveString);
+			if (reply == moveString) {
+				chosen = i;
+			}
+		}
+		if (chosen < 0) {
+			if (reply.empty()) {
+				engine.resync(2000);
+			}
+			return loss;
+		}
+
+		Move& move = legal[chosen];
+		char command[32];
+		snprintf(command, sizeof(command), "move %c%c %c%c %d\n",
+			'a' + move.from % 16, '1' + move.from / 16, 'a' + move.to % 16, '1' + move.to / 16, move.type);
+		moves += command;
+		game.makeMove(&move);
+	}
+	return 0.5;
+}
+
+
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		printf("Usage: match <engine A> <engine B> [-games n] [-concurrency n] [-movetime ms] [-openings file] [-elo0 x] [-elo1 x] [-alpha x] [-beta x]\n");
+		return -1;
+	}
+	signal(SIGPIPE, SIG_IGN); // an engine that dies shows up as a lost game, not a dead match
+	std::string engines[2] = { argv[1], argv[2] };
+	int games = 200, concurrency = std::max(1u, std::thread::hardware_concurrency()), movetime = 50, maxPlies = 400;
+	double elo0 = 0, elo1 = 10, alpha = 0.05, beta = 0.05;
+	const char* openingsPath = nullptr;
+	for (int i = 3; i + 1 < argc; i += 2) {
+		std::string name = argv[i];
+		if (name == "-games") {
+			games = std::stoi(argv[i + 1]);
+		}
+		else if (name == "-concurrency") {
+			concurrency = std::max(1, std::stoi(argv[i + 1]));
+		}
+		else if (name == "-movetime") {
+			movetime = std::stoi(argv[i + 1]);
+		}
+		else if (name == "-openings") {
+			openingsPath = argv[i + 1];
+		}
+		else if (name == "-elo0") {
+			elo0 = std::stod(argv[i + 1]);
+		}
+		else if (name == "-elo1") {
+			elo1 = std::stod(argv[i + 1]);
+		}
+		else if (name == "-alpha") {
+			alpha = std::stod(argv[i + 1]);
+		}
+		else if (name == "-beta") {
+			beta = std::stod(argv[i + 1]);
+		}
+	}
+
+	std::vector<std::string> openings = {
+		"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+		"rnbqkbnr/pppp1ppp/8/4p3/4P3/8/PPPP1PPP/RNBQKBNR w KQkq - 0 2",
+		"rnbqkbnr/pp1ppppp/8/2p5/4P3/8/PPPP1PPP/RNBQKBNR w KQkq - 0 2",
+		"rnbqkbnr/ppp1pppp/8/3p4/3P4/8/PPP1PPPP/RNBQKBNR w KQkq - 0 2",
+		"rnbqkb1r/pppppppp/5n2/8/2P5/8/PP1PPPPP/RNBQKBNR w KQkq - 1 2",
+		"r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+		"rnbqkbnr/pppp1ppp/4p3/8/3PP3/8/PPP2PPP/RNBQKBNR b KQkq - 0 2",
+		"rnbqkb1r/pppppp1p/5np1/8/2PP4/8/PP2PPPP/RNBQKBNR w KQkq - 0 3"
+	};
+	if (openingsPath != nullptr) {
+		std::ifstream in(openingsPath);
+		if (!in) {
+			printf("Could not open %s\n", openingsPath);
+			return -1;
+		}
+		openings.clear();
+		std::string line;
+		Board check;
+		while (std::getline(in, line)) {
+			if (!line.empty() && check.parseFEN(line).ok()) {
+				openings.push_back(line);
+			}
+		}
+		if (openings.empty()) {
+			printf("No valid openings in %s\n", openingsPath);
+			return -1;
+		}
+	}
+
+	double lower = std::log(beta / (1 - alpha)), upper = std::log((1 - beta) / alpha);
+	printf("%s vs %s: %d games, %d at a time, %d ms/move, SPRT elo0 %.1f elo1 %.1f (bounds %.2f, %.2f)\n",
+		engines[0].c_str(), engines[1].c_str(), games, concurrency, movetime, elo0, elo1, lower, upper);
+
+	std::mutex mutex;
+	Score score;
+	std::atomic<int> nextGame(0);
+	std::atomic<bool> decided(false);
+	int verdict = 2;
+
+	auto worker = [&]() {
+		Engine a(engines[0]), b(engines[1]);
+		if (!a.running() || !b.running()) {
+			printf("Could not start the engines\n");
+			return;
+		}
+		int index;
+		while (!decided && (index = nextGame++) < games) {
+			// game pairs: A plays white in even games, black in odd ones
+			const std::string& opening = openings[(index / 2) % openings.size()];
+			bool aWhite = index % 2 == 0;
+			double result = aWhite ? playGame(a, b, opening, movetime, maxPlies) : 1 - playGame(b, a, opening, movetime, maxPlies);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			score.wins += result == 1;
+			score.draws += result == 0.5;
+			score.losses += result == 0;
+
+			double mean, variance;
+			scoreStatistics(score, mean, variance);
+			double margin = 1.96 * std::sqrt(variance / score.games());
+			double elo = eloFromScore(mean);
+			double eloLow = eloFromScore(mean - margin), eloHigh = eloFromScore(mean + margin);
+			double llr = logLikelihoodRatio(score, elo0, elo1);
+			printf("Games %d: +%d =%d -%d, Elo %.1f [%.1f, %.1f], LLR %.2f\n",
+				score.games(), score.wins, score.draws, score.losses, elo, eloLow, eloHigh, llr);
+			fflush(stdout);
+
+			if (!decided && (llr >= upper || llr <= lower)) {
+				decided = true;
+				verdict = llr >= upper ? 0 : 1;
+			}
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (int i = 0; i < concurrency; i++) {
+		workers.emplace_back(worker);
+	}
+	for (std::thread& thread : workers) {
+		thread.join();
+	}
+
+	const char* verdicts[] = { "H1 accepted: A is stronger by at least elo1", "H0 accepted: A is not stronger by elo1", "inconclusive" };
+	printf("SPRT: %s\n", verdicts[verdict]);
+	return verdict;
+}
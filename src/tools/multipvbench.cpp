@@ -0,0 +1,49 @@
+// MultiPV overhead benchmark: cost of searching the best N lines relative to a single-PV search
+// Usage: multipvbench [depth] [max lines]
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include "../Board.h"
+#include "../TranspositionTable.h"
+
+
+int main(int argc, char** argv) {
+	int depth = argc > 1 ? std::stoi(argv[1]) : 5;
+	int maxLines = argc > 2 ? std::stoi(argv[2]) : 8;
+	const char* fens[] = {
+		"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+		"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+		"r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4",
+		"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+		"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1"
+	};
+
+	TranspositionTable table(64);
+	double baseTime = 0;
+	unsigned long long baseNodes = 0;
+	printf("lines,time_ms,nodes,time_ratio,node_ratio\n");
+	for (int lines = 1; lines <= maxLines; lines++) {
+		double milliseconds = 0;
+		unsigned long long nodes = 0;
+		for (const char* fen : fens) {
+			Board position;
+			position.loadPosition(fen);
+			table.clear();
+			SearchInfo info;
+			info.table = &table;
+			position.searchInfo = &info;
+
+			PVLine result[SearchInfo::MAX_PV];
+			auto start = std::chrono::steady_clock::now();
+			position.searchMultiPV(result, lines, depth);
+			milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			nodes += info.nodes;
+		}
+		if (lines == 1) {
+			baseTime = milliseconds;
+			baseNodes = nodes;
+		}
+		printf("%d,%.1f,%llu,%.2f,%.2f\n", lines, milliseconds, nodes, milliseconds / baseTime, double(nodes) / baseNodes);
+	}
+	return 0;
+}
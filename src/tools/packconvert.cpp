@@ -0,0 +1,104 @@
+// Converts between FEN text and packed positions
+// Usage:
+//	packconvert pack <fen file> <packed file>
+//	packconvert unpack <packed file> <fen file>
+//	packconvert dump <datagen file>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include "../Board.h"
+#include "../Datagen.h"
+#include "../MappedReader.h"
+#include "../PackedPosition.h"
+
+
+static int pack(const char* input, const char* output) {
+	std::ifstream in(input);
+	FILE* out = fopen(output, "wb");
+	if (!in || out == nullptr) {
+		printf("Could not open files\n");
+		return -1;
+	}
+
+	std::string line;
+	Board position;
+	PackedPosition packed;
+	size_t count = 0;
+	while (std::getline(in, line)) {
+		if (line.empty()) {
+			continue;
+		}
+		FenResult result = position.parseFEN(line);
+		if (!result.ok()) {
+			printf("Skipping invalid FEN (%s at character %d): %s\n", result.message(), result.offset, line.c_str());
+			continue;
+		}
+		if (!packed.encode(position)) {
+			printf("Skipping position with too many pieces: %s\n", line.c_str());
+			continue;
+		}
+		fwrite(&packed, sizeof(PackedPosition), 1, out);
+		count++;
+	}
+	fclose(out);
+	printf("Packed %zu positions\n", count);
+	return 0;
+}
+
+static int unpack(const char* input, const char* output) {
+	MappedReader<PackedPosition> records;
+	FILE* out = fopen(output, "w");
+	if (!records.open(input) || out == nullptr) {
+		printf("Could not open files\n");
+		return -1;
+	}
+
+	Board position;
+	size_t count = 0;
+	for (const PackedPosition& packed : records) {
+		if (!packed.decode(position)) {
+			printf("Skipping corrupt record %zu\n", size_t(&packed - records.begin()));
+			continue;
+		}
+		fprintf(out, "%s\n", position.toFEN().c_str());
+		count++;
+	}
+	fclose(out);
+	printf("Unpacked %zu positions\n", count);
+	return 0;
+}
+
+static int dump(const char* input) {
+	MappedReader<DataRecord> records;
+	if (!records.open(input)) {
+		printf("Could not open %s\n", input);
+		return -1;
+	}
+
+	const char* results[] = { "0-1", "1/2-1/2", "1-0" };
+	Board position;
+	for (const DataRecord& record : records) {
+		if (!record.position.decode(position)) {
+			printf("Corrupt record %zu\n", size_t(&record - records.begin()));
+			continue;
+		}
+		printf("%s | %d | %s\n", position.toFEN().c_str(), record.score, results[record.result % 3]);
+	}
+	return 0;
+}
+
+
+int main(int argc, char** argv) {
+	std::string mode = argc > 1 ? argv[1] : "";
+	if (mode == "pack" && argc == 4) {
+		return pack(argv[2], argv[3]);
+	}
+	if (mode == "unpack" && argc == 4) {
+		return unpack(argv[2], argv[3]);
+	}
+	if (mode == "dump" && argc == 3) {
+		return dump(argv[2]);
+	}
+	printf("Usage:\n\tpackconvert pack <fen file> <packed file>\n\tpackconvert unpack <packed file> <fen file>\n\tpackconvert dump <datagen file>\n");
+	return -1;
+}
@@ -0,0 +1,293 @@
+// Resumable perft split into subtree jobs kept in a work file. Any number of local worker processes claim jobs under an
+// exclusive file lock and checkpoint each result as it finishes; jobs claimed by a process that no longer exists are
+// claimed again, so an interrupted run resumes by starting the workers again.
+// Usage:
+//	perftjobs split <work file> <depth> <split depth> [fen]
+//	perftjobs work <work file> [processes]
+//	perftjobs merge <work file>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "../Board.h"
+
+
+// Every line of the work file has the same length so records can be rewritten in place.
+// Header: "perftjobs <depth> <split depth> <jobs> <fen>"
+// Job:    "<state> <pid> <root move> <multiplicity> <count> <fen>" with state P(ending), C(laimed) or D(one)
+static const int RECORD = 192;
+
+struct Job {
+	char state;
+	int pid;
+	char rootMove[6];
+	unsigned long long multiplicity; // move sequences from the root that reach this position
+	unsigned long long count; // perft of the position, valid once done
+	char fen[96];
+};
+
+// Pads text written into record out to a full line; returns false if it didn't fit
+static bool finishRecord(char* record, int length) {
+	if (length < 0 || length >= RECORD) {
+		return false;
+	}
+	std::memset(record + length, ' ', RECORD - 1 - length);
+	record[RECORD - 1] = '\n';
+	return true;
+}
+
+static bool formatJob(const Job& job, char* record) {
+	return finishRecord(record, snprintf(record, RECORD, "%c %10d %-5s %12llu %20llu %s", job.state, job.pid, job.rootMove, job.multiplicity, job.count, job.fen));
+}
+
+static bool parseJob(const char* record, Job& job) {
+	std::string line(record, RECORD - 1);
+	char fen[RECORD];
+	if (sscanf(line.c_str(), "%c %d %5s %llu %llu %[^\n]", &job.state, &job.pid, job.rootMove, &job.multiplicity, &job.count, fen) != 6) {
+		return false;
+	}
+	std::string trimmed(fen);
+	trimmed.erase(trimmed.find_last_not_of(' ') + 1);
+	snprintf(job.fen, sizeof(job.fen), "%s", trimmed.c_str());
+	return true;
+}
+
+struct Header {
+	int depth;
+	int splitDepth;
+	int jobs;
+};
+
+static bool readHeader(int fd, Header& header) {
+	char record[RECORD + 1] = {};
+	return pread(fd, record, RECORD, 0) == RECORD
+		&& sscanf(record, "perftjobs %d %d %d", &header.depth, &header.splitDepth, &header.jobs) == 3;
+}
+
+
+// Collects every position splitDepth plies below position, merging transpositions within each root move
+static void collect(Board& position, int plies, const char* rootMove, std::map<std::string, size_t>& index, std::vector<Job>& jobs) {
+	if (plies == 0) {
+		std::string key = std::string(rootMove) + " " + position.toFEN();
+		auto found = index.find(key);
+		if (found != index.end()) {
+			jobs[found->second].multiplicity++;
+			return;
+		}
+		Job job = {};
+		job.state = 'P';
+		std::strcpy(job.rootMove, rootMove);
+		job.multiplicity = 1;
+		position.writeFEN(job.fen);
+		index[key] = jobs.size();
+		jobs.push_back(job);
+		return;
+	}
+
+	Board currentPosition = position;
+	MoveList moves = position.GenerateMoves();
+	Move* currentMove;
+	while ((currentMove = moves.pop_front()) != nullptr) {
+		if (position.makeMove(currentMove)) {
+			char moveString[6];
+			currentPosition.moveToString(*currentMove, moveString);
+			collect(position, plies - 1, rootMove[0] ? rootMove : moveString, index, jobs);
+		}
+		position = currentPosition;
+	}
+}
+
+static int split(const char* path, int depth, int splitDepth, const char* fen) {
+	Board position;
+	if (!position.loadPosition(fen)) {
+		return -1;
+	}
+	splitDepth = std::max(1, std::min(splitDepth, depth));
+
+	std::map<std::string, size_t> index;
+	std::vector<Job> jobs;
+	collect(position, splitDepth, "", index, jobs);
+
+	// every record is formatted before the file is created, so one that doesn't fit leaves nothing behind; the header
+	// holds the parsed position rather than the argument, which may carry EPD operations
+	std::vector<char> records((jobs.size() + 1) * RECORD + 1);
+	char positionFEN[96];
+	position.writeFEN(positionFEN);
+	bool fits = finishRecord(records.data(), snprintf(records.data(), RECORD, "perftjobs %d %d %zu %s", depth, splitDepth, jobs.size(), positionFEN));
+	for (size_t i = 0; i < jobs.size() && fits; i++) {
+		fits = formatJob(jobs[i], &records[(i + 1) * RECORD]);
+	}
+	if (!fits) {
+		printf("A record does not fit in %d bytes\n", RECORD);
+		return -1;
+	}
+
+	FILE* file = fopen(path, "wx");
+	if (file == nullptr) {
+		printf("Could not create %s (it may already exist)\n", path);
+		return -1;
+	}
+	fwrite(records.data(), 1, records.size() - 1, file);
+	fclose(file);
+	printf("Wrote %zu jobs of depth %d to %s\n", jobs.size(), depth - splitDepth, path);
+	return 0;
+}
+
+
+// Where a worker resumes looking for jobs. Pending jobs are only ever claimed, never released, so records a worker has
+// passed stay taken and each worker reads the file about once instead of from the start on every claim
+struct Cursor {
+	int pending = 1; // records before this aren't pending
+	int abandoned = 1; // next record to check for a dead worker's claim, once no jobs are pending
+};
+
+// Claims the next pending job, or once there are none one whose worker died; returns its index or -1 when none are left
+static int claim(int fd, const Header& header, Cursor& cursor, Job& job) {
+	flock(fd, LOCK_EX);
+	char record[RECORD];
+	int claimed = -1;
+	while (claimed < 0 && cursor.abandoned <= header.jobs) {
+		bool pending = cursor.pending <= header.jobs;
+		int i = pending ? cursor.pending++ : cursor.abandoned++;
+		if (pread(fd, record, RECORD, off_t(i) * RECORD) != RECORD || !parseJob(record, job)) {
+			continue;
+		}
+		bool abandoned = !pending && job.state == 'C' && kill(job.pid, 0) != 0 && errno == ESRCH;
+		if ((pending && job.state == 'P') || abandoned) {
+			job.state = 'C';
+			job.pid = getpid();
+			formatJob(job, record);
+			pwrite(fd, record, RECORD, off_t(i) * RECORD);
+			claimed = i;
+		}
+	}
+	flock(fd, LOCK_UN);
+	return claimed;
+}
+
+// Records a finished job; results are flushed to disk at most once a second, as a job whose result is lost in a crash is
+// only claimed and searched again
+static void complete(int fd, int index, Job& job, time_t& lastSync) {
+	char record[RECORD];
+	job.state = 'D';
+	formatJob(job, record);
+	flock(fd, LOCK_EX);
+	pwrite(fd, record, RECORD, off_t(index) * RECORD);
+	flock(fd, LOCK_UN);
+	if (time(nullptr) != lastSync) {
+		fdatasync(fd);
+		lastSync = time(nullptr);
+	}
+}
+
+static void workLoop(const char* path) {
+	int fd = open(path, O_RDWR);
+	Header header;
+	if (fd < 0 || !readHeader(fd, header)) {
+		printf("Could not read %s\n", path);
+		return;
+	}
+	Cursor cursor;
+	Job job;
+	time_t lastSync = time(nullptr);
+	int index, done = 0;
+	while ((index = claim(fd, header, cursor, job)) > 0) {
+		Board position;
+		position.parseFEN(job.fen);
+		position.depth = 0; // no divide output
+		job.count = position.perft(header.depth - header.splitDepth);
+		complete(fd, index, job, lastSync);
+		done++;
+	}
+	fdatasync(fd);
+	close(fd);
+	printf("Worker %d finished %d jobs\n", getpid(), done);
+}
+
+static int work(const char* path, int processes) {
+	std::vector<pid_t> children;
+	for (int i = 0; i < processes; i++) {
+		pid_t pid = fork();
+		if (pid == 0) {
+			workLoop(path);
+			fflush(stdout);
+			_exit(0);
+		}
+		children.push_back(pid);
+	}
+	for (pid_t pid : children) {
+		waitpid(pid, nullptr, 0);
+	}
+	return 0;
+}
+
+
+static int merge(const char* path) {
+	int fd = open(path, O_RDONLY);
+	Header header;
+	if (fd < 0 || !readHeader(fd, header)) {
+		printf("Could not read %s\n", path);
+		return -1;
+	}
+
+	std::map<std::string, unsigned long long> divide;
+	std::vector<std::string> order;
+	int pending = 0;
+	char record[RECORD];
+	Job job;
+	for (int i = 1; i <= header.jobs; i++) {
+		if (pread(fd, record, RECORD, off_t(i) * RECORD) != RECORD || !parseJob(record, job)) {
+			printf("Corrupt record %d\n", i);
+			close(fd);
+			return -1;
+		}
+		if (!divide.count(job.rootMove)) {
+			order.push_back(job.rootMove);
+			divide[job.rootMove] = 0;
+		}
+		if (job.state != 'D') {
+			pending++;
+			continue;
+		}
+		divide[job.rootMove] += job.multiplicity * job.count;
+	}
+	close(fd);
+
+	unsigned long long total = 0;
+	for (const std::string& move : order) {
+		printf("%s: %llu\n", move.c_str(), divide[move]);
+		total += divide[move];
+	}
+	printf("\nDepth: %d\nPositions: %llu\n", header.depth, total);
+	if (pending > 0) {
+		printf("Incomplete: %d of %d jobs not done\n", pending, header.jobs);
+		return 1;
+	}
+	return 0;
+}
+
+
+int main(int argc, char** argv) {
+	std::string mode = argc > 1 ? argv[1] : "";
+	if (mode == "split" && (argc == 5 || argc == 6)) {
+		const char* fen = argc == 6 ? argv[5] : "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+		return split(argv[2], std::stoi(argv[3]), std::stoi(argv[4]), fen);
+	}
+	if (mode == "work" && (argc == 3 || argc == 4)) {
+		return work(argv[2], argc == 4 ? std::max(1, std::stoi(argv[3])) : 1);
+	}
+	if (mode == "merge" && argc == 3) {
+		return merge(argv[2]);
+	}
+	printf("Usage:\n\tperftjobs split <work file> <depth> <split depth> [fen]\n\tperftjobs work <work file> [processes]\n\tperftjobs merge <work file>\n");
+	return -1;
+}
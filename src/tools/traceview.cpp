@@ -0,0 +1,289 @@
+// Rebuilds the search trees of a trace written by ChessAI-trace and reports where the nodes went:
+// hot subtrees near the root, positions searched again at the same depth within one search, and late cutoffs.
+// Usage: traceview <trace file> [-top <n>] [-ply <deepest ply for hot subtrees>]
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../Trace.h"
+
+
+// Interior node on a thread's stack
+struct Frame {
+	TraceRecord enter;
+	unsigned long long nodes; // this node and every finished descendant
+	unsigned long long lastChild; // nodes of the most recently finished child
+};
+
+// Visits of one (position, depth) within a search
+struct Visits {
+	int count;
+	unsigned long long nodes;
+	unsigned long long firstNodes;
+	std::string path; // of the second visit
+};
+
+// Keeps the n largest items by key
+template <typename T>
+struct TopList {
+	size_t limit;
+	std::priority_queue<std::pair<unsigned long long, T>, std::vector<std::pair<unsigned long long, T>>, std::greater<std::pair<unsigned long long, T>>> heap;
+
+	void add(unsigned long long key, const T& item) {
+		if (heap.size() < limit || key > heap.top().first) {
+			heap.emplace(key, item);
+			if (heap.size() > limit) {
+				heap.pop();
+			}
+		}
+	}
+
+	// Returns the items, largest first
+	std::vector<std::pair<unsigned long long, T>> sorted() {
+		std::vector<std::pair<unsigned long long, T>> items;
+		while (!heap.empty()) {
+			items.push_back(heap.top());
+			heap.pop();
+		}
+		std::reverse(items.begin(), items.end());
+		return items;
+	}
+};
+
+struct ThreadState {
+	std::vector<Frame> stack;
+	std::map<std::pair<unsigned long long, int>, Visits> visits; // of the current search
+	int search; // index in Report::searches
+};
+
+struct SearchSummary {
+	int thread;
+	int depth;
+	unsigned long long nodes;
+	unsigned long long repeatedNodes; // in visits after the first of a (position, depth)
+};
+
+struct Report {
+	int maxPly;
+	unsigned long long kinds[4] = {};
+	unsigned long long bounds[5] = {}; // EXIT records by bound
+	unsigned long long unfinished = 0; // interior nodes without an EXIT record
+	unsigned long long cutoffs[5] = {}; // by move index: 0, 1, 2, 3-5, 6+
+	std::vector<SearchSummary> searches;
+	TopList<std::string> hot;
+	TopList<std::string> repeated;
+	TopList<std::string> lateCutoffs;
+	std::map<int, ThreadState> threads;
+};
+
+
+// Coordinate notation of a recorded move, "-" for none
+static std::string moveString(unsigned char from, unsigned char to, unsigned char type) {
+	if (from == to) {
+		return "-";
+	}
+	char text[6] = { char('a' + from % 16), char('1' + from / 16), char('a' + to % 16), char('1' + to / 16), 0, 0 };
+	if (type >= 4 && type <= 7) {
+		text[4] = "qnbr"[type - 4];
+	}
+	return text;
+}
+
+// Moves from the root to the top of the stack, followed by extra
+static std::string pathOf(const std::vector<Frame>& stack, const std::string& extra = "") {
+	std::string path;
+	for (size_t i = 1; i < stack.size(); i++) {
+		path += moveString(stack[i].enter.from, stack[i].enter.to, stack[i].enter.moveType) + " ";
+	}
+	path += extra;
+	return path.empty() ? "(root)" : path;
+}
+
+// Removes the top frame, crediting its nodes to its parent and to the per-search statistics
+static void finish(Report& report, ThreadState& state, bool exited) {
+	Frame frame = state.stack.back();
+	const TraceRecord& enter = frame.enter;
+	if (!exited) {
+		report.unfinished++;
+	}
+
+	if (enter.ply > 0 && enter.ply <= report.maxPly) {
+		char label[64];
+		snprintf(label, sizeof(label), "  (search %d, depth %d)", state.search + 1, enter.depth);
+		report.hot.add(frame.nodes, pathOf(state.stack) + label);
+	}
+	Visits& visits = state.visits[{ enter.hash, enter.depth }];
+	visits.count++;
+	visits.nodes += frame.nodes;
+	if (visits.count == 1) {
+		visits.firstNodes = frame.nodes;
+	}
+	else if (visits.count == 2) {
+		visits.path = pathOf(state.stack);
+	}
+	state.stack.pop_back();
+
+	if (!state.stack.empty()) {
+		state.stack.back().nodes += frame.nodes;
+		state.stack.back().lastChild = frame.nodes;
+		return;
+	}
+
+	// the root is done: the search summary and its repeated positions
+	SearchSummary& search = report.searches[state.search];
+	search.nodes = frame.nodes;
+	for (auto& entry : state.visits) {
+		if (entry.second.count > 1) {
+			unsigned long long extra = entry.second.nodes - entry.second.firstNodes;
+			search.repeatedNodes += extra;
+			char label[96];
+			snprintf(label, sizeof(label), "  (search %d, depth %d, %d visits, %llx)",
+				state.search + 1, entry.first.second, entry.second.count, entry.first.first);
+			report.repeated.add(extra, entry.second.path + label);
+		}
+	}
+	state.visits.clear();
+}
+
+// Pops the frames at ply or deeper whose EXIT records are missing
+static void unwind(Report& report, ThreadState& state, int ply) {
+	while (!state.stack.empty() && state.stack.back().enter.ply >= ply) {
+		finish(report, state, false);
+	}
+}
+
+static void process(Report& report, const TraceRecord& record) {
+	if (record.kind > Trace::CUTOFF) {
+		return;
+	}
+	report.kinds[record.kind]++;
+	ThreadState& state = report.threads[record.thread];
+
+	switch (record.kind) {
+	case Trace::ENTER:
+		unwind(report, state, record.ply);
+		if (record.ply == 0) {
+			state.search = report.searches.size();
+			report.searches.push_back({ record.thread, record.depth, 0, 0 });
+		}
+		else if (state.stack.empty()) {
+			return; // the trace started inside a search
+		}
+		state.stack.push_back({ record, 1, 0 });
+		break;
+
+	case Trace::EVAL:
+		unwind(report, state, record.ply);
+		if (!state.stack.empty()) {
+			state.stack.back().nodes++;
+			state.stack.back().lastChild = 1;
+		}
+		break;
+
+	case Trace::CUTOFF:
+		if (!state.stack.empty() && state.stack.back().enter.ply == record.ply) {
+			int index = record.moveIndex;
+			report.cutoffs[index == 0 ? 0 : index == 1 ? 1 : index == 2 ? 2 : index <= 5 ? 3 : 4]++;
+			if (index > 0) {
+				Frame& frame = state.stack.back();
+				unsigned long long wasted = frame.nodes - 1 - frame.lastChild;
+				char label[96];
+				snprintf(label, sizeof(label), "  (search %d, depth %d, cutoff by move %d)", state.search + 1, record.depth, index + 1);
+				report.lateCutoffs.add(wasted, pathOf(state.stack, "[" + moveString(record.from, record.to, record.moveType) + "]") + label);
+			}
+		}
+		break;
+
+	case Trace::EXIT:
+		report.bounds[std::min<int>(record.bound, 4)]++;
+		unwind(report, state, record.ply + 1);
+		if (!state.stack.empty() && state.stack.back().enter.ply == record.ply) {
+			finish(report, state, true);
+		}
+		break;
+	}
+}
+
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		printf("Usage: traceview <trace file> [-top <n>] [-ply <deepest ply for hot subtrees>]\n");
+		return -1;
+	}
+	int top = 10;
+	Report report;
+	report.maxPly = 2;
+	for (int i = 2; i + 1 < argc; i += 2) {
+		if (std::strcmp(argv[i], "-top") == 0) {
+			top = std::max(1, atoi(argv[i + 1]));
+		}
+		else if (std::strcmp(argv[i], "-ply") == 0) {
+			report.maxPly = std::max(1, atoi(argv[i + 1]));
+		}
+	}
+	report.hot.limit = report.repeated.limit = report.lateCutoffs.limit = top;
+
+	FILE* file = fopen(argv[1], "rb");
+	TraceHeader header;
+	if (file == nullptr || fread(&header, sizeof(header), 1, file) != 1 || std::memcmp(header.magic, "CHESSTRC", 8) != 0
+		|| header.version != Trace::VERSION || header.recordSize != sizeof(TraceRecord)) {
+		printf("%s is not a trace file of this version\n", argv[1]);
+		return -1;
+	}
+	std::vector<TraceRecord> chunk(1 << 16);
+	size_t count;
+	unsigned long long records = 0;
+	while ((count = fread(chunk.data(), sizeof(TraceRecord), chunk.size(), file)) > 0) {
+		for (size_t i = 0; i < count; i++) {
+			process(report, chunk[i]);
+		}
+		records += count;
+	}
+	fclose(file);
+	for (auto& entry : report.threads) {
+		unwind(report, entry.second, 0);
+	}
+
+	unsigned long long nodes = report.kinds[Trace::ENTER] + report.kinds[Trace::EVAL];
+	printf("Records: %llu from %zu threads, %zu searches\n", records, report.threads.size(), report.searches.size());
+	printf("Nodes: %llu (%llu interior, %llu leaves), %llu interior nodes without an exit\n",
+		nodes, report.kinds[Trace::ENTER], report.kinds[Trace::EVAL], report.unfinished);
+	printf("Exits: %llu exact, %llu fail high, %llu fail low, %llu hash cutoffs, %llu draws\n",
+		report.bounds[0], report.bounds[1], report.bounds[2], report.bounds[3], report.bounds[4]);
+
+	printf("\nSearches (root depth: nodes, nodes repeated at the same position and depth):\n");
+	for (size_t i = 0; i < report.searches.size(); i++) {
+		const SearchSummary& search = report.searches[i];
+		printf("%4zu  thread %d  depth %2d: %12llu nodes, %10llu repeated (%.1f%%)\n", i + 1, search.thread, search.depth,
+			search.nodes, search.repeatedNodes, search.nodes ? search.repeatedNodes * 100.0 / search.nodes : 0);
+	}
+
+	printf("\nHot subtrees up to ply %d:\n", report.maxPly);
+	for (auto& item : report.hot.sorted()) {
+		printf("%12llu  %s\n", item.first, item.second.c_str());
+	}
+
+	printf("\nRe-search storms (extra nodes after the first visit):\n");
+	for (auto& item : report.repeated.sorted()) {
+		printf("%12llu  %s\n", item.first, item.second.c_str());
+	}
+
+	unsigned long long cutoffs = 0;
+	for (unsigned long long count : report.cutoffs) {
+		cutoffs += count;
+	}
+	printf("\nCutoffs: %llu; by move 1: %.1f%%, 2: %.1f%%, 3: %.1f%%, 4-6: %.1f%%, 7+: %.1f%%\n", cutoffs,
+		cutoffs ? report.cutoffs[0] * 100.0 / cutoffs : 0, cutoffs ? report.cutoffs[1] * 100.0 / cutoffs : 0,
+		cutoffs ? report.cutoffs[2] * 100.0 / cutoffs : 0, cutoffs ? report.cutoffs[3] * 100.0 / cutoffs : 0,
+		cutoffs ? report.cutoffs[4] * 100.0 / cutoffs : 0);
+	printf("\nWorst ordering failures (nodes searched before the cutoff move, nested subtrees included):\n");
+	for (auto& item : report.lateCutoffs.sorted()) {
+		printf("%12llu  %s\n", item.first, item.second.c_str());
+	}
+	return 0;
+}
@@ -0,0 +1,95 @@
+// Warm-versus-cold benchmark for the persistent transposition table: searches a position set into a fresh table file,
+// reopens the file and searches the same positions again
+// Usage: ttbench <table file> [depth] [megabytes] [fen file]
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "../Board.h"
+#include "../TranspositionTable.h"
+
+
+// Searches every position to depth; adds the time and nodes of each one to the totals
+static void searchAll(TranspositionTable& table, const std::vector<std::string>& fens, int depth,
+	std::vector<double>& milliseconds, std::vector<unsigned long long>& nodes) {
+	for (const std::string& fen : fens) {
+		Board position;
+		position.loadPosition(fen);
+		SearchInfo info;
+		info.table = &table;
+		position.searchInfo = &info;
+		table.newSearch();
+
+		Move bestMove;
+		auto start = std::chrono::steady_clock::now();
+		position.iterativeDeepening(bestMove, depth);
+		milliseconds.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		nodes.push_back(info.nodes);
+	}
+}
+
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		printf("Usage: ttbench <table file> [depth] [megabytes] [fen file]\n");
+		return -1;
+	}
+	std::string path = argv[1];
+	int depth = argc > 2 ? std::stoi(argv[2]) : 6;
+	size_t megabytes = argc > 3 ? std::stoul(argv[3]) : 64;
+	std::vector<std::string> fens = {
+		"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+		"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+		"r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4",
+		"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+		"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1"
+	};
+	if (argc > 4) {
+		std::ifstream in(argv[4]);
+		if (!in) {
+			printf("Could not open %s\n", argv[4]);
+			return -1;
+		}
+		fens.clear();
+		std::string line;
+		while (std::getline(in, line)) {
+			if (!line.empty()) {
+				fens.push_back(line);
+			}
+		}
+	}
+
+	std::vector<double> coldTime, warmTime;
+	std::vector<unsigned long long> coldNodes, warmNodes;
+	{
+		unlink(path.c_str());
+		TranspositionTable table(1);
+		if (!table.open(path, megabytes)) {
+			return -1;
+		}
+		searchAll(table, fens, depth, coldTime, coldNodes);
+	}
+	{
+		// a new table object, so everything it knows comes from the file
+		TranspositionTable table(1);
+		if (!table.open(path, megabytes)) {
+			return -1;
+		}
+		searchAll(table, fens, depth, warmTime, warmNodes);
+	}
+
+	printf("position,cold_ms,warm_ms,cold_nodes,warm_nodes,speedup\n");
+	double coldTotal = 0, warmTotal = 0;
+	unsigned long long coldNodeTotal = 0, warmNodeTotal = 0;
+	for (size_t i = 0; i < fens.size(); i++) {
+		printf("%zu,%.1f,%.1f,%llu,%llu,%.2f\n", i, coldTime[i], warmTime[i], coldNodes[i], warmNodes[i], coldTime[i] / warmTime[i]);
+		coldTotal += coldTime[i];
+		warmTotal += warmTime[i];
+		coldNodeTotal += coldNodes[i];
+		warmNodeTotal += warmNodes[i];
+	}
+	printf("total,%.1f,%.1f,%llu,%llu,%.2f\n", coldTotal, warmTotal, coldNodeTotal, warmNodeTotal, coldTotal / warmTotal);
+	return 0;
+}
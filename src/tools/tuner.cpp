@@ -0,0 +1,287 @@
+// Texel tuner: fits pieceValues and the piece-square tables to self-play game results
+// Usage: tuner <output header> <epochs> <threads> <datagen files...>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "../Board.h"
+#include "../Datagen.h"
+#include "../MappedReader.h"
+#include "../Material.h"
+
+
+// Positions in compact sparse form; terms of position i are [offset[i], offset[i + 1])
+struct TuningSet {
+	std::vector<unsigned int> offset;
+	std::vector<unsigned short> index;
+	std::vector<signed char> coefficient;
+	std::vector<unsigned char> kingSquares;
+	std::vector<float> phase;
+	std::vector<short> imbalance; // material table imbalance in centipawns for white, which the weights don't change
+	std::vector<float> result;
+
+	size_t size() const {
+		return result.size();
+	}
+};
+
+
+// Evaluation of position i in centipawns for the given weights
+static inline double linearEval(const TuningSet& set, size_t i, const double* weights) {
+	double eval = set.imbalance[i];
+	for (unsigned int t = set.offset[i]; t < set.offset[i + 1]; t++) {
+		eval += set.coefficient[t] * weights[set.index[t]];
+	}
+	double phase = set.phase[i];
+	int white = set.kingSquares[2 * i], black = set.kingSquares[2 * i + 1];
+	eval += (1 - phase) * weights[EvalWeights::KING_MIDDLE + white] + phase * weights[EvalWeights::KING_END + white];
+	eval -= (1 - phase) * weights[EvalWeights::KING_MIDDLE + black] + phase * weights[EvalWeights::KING_END + black];
+	return eval;
+}
+
+static inline double sigmoid(double eval, double k) {
+	return 1 / (1 + std::pow(10.0, -k * eval / 400));
+}
+
+
+// Reads datagen records and converts them to sparse terms; returns the number of positions added. Corrupt records are
+// skipped, and so are known and drawish endings, which the engine scores with the material table instead of the weights
+static size_t loadFile(const char* path, TuningSet& set) {
+	MappedReader<DataRecord> records;
+	if (!records.open(path)) {
+		printf("Could not open %s\n", path);
+		return 0;
+	}
+
+	Board position;
+	EvalTerms terms;
+	size_t added = 0, corrupt = 0;
+	for (const DataRecord& record : records) {
+		if (!record.position.decode(position)) {
+			corrupt++;
+			continue;
+		}
+		const MaterialEntry* material = Material::probe(position.materialKey);
+		int scale[2];
+		Material::scaleFactors(position, material, scale);
+		if (material->evaluator != nullptr || scale[0] != Material::SCALE_NORMAL || scale[1] != Material::SCALE_NORMAL) {
+			continue;
+		}
+		added++;
+		position.evaluationTerms(terms);
+		for (int t = 0; t < terms.count; t++) {
+			set.index.push_back(terms.index[t]);
+			set.coefficient.push_back(terms.coefficient[t]);
+		}
+		set.offset.push_back(set.index.size());
+		set.kingSquares.push_back(terms.kingSquare[0]);
+		set.kingSquares.push_back(terms.kingSquare[1]);
+		set.phase.push_back(terms.phase);
+		set.imbalance.push_back(material->imbalance);
+		set.result.push_back(record.result / 2.0f);
+	}
+	if (added < records.size()) {
+		printf("Skipped %zu corrupt records and %zu known or drawish endings in %s\n", corrupt, records.size() - added - corrupt, path);
+	}
+	return added;
+}
+
+
+// Runs fn(begin, end, thread) over the whole set split across threads
+template <typename Fn>
+static void parallelFor(size_t size, int threads, Fn fn) {
+	std::vector<std::thread> workers;
+	size_t chunk = (size + threads - 1) / threads;
+	for (int t = 0; t < threads; t++) {
+		size_t begin = std::min(size, t * chunk), end = std::min(size, begin + chunk);
+		workers.emplace_back(fn, begin, end, t);
+	}
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+}
+
+// Mean squared error of the predicted results
+static double totalError(const TuningSet& set, const double* weights, double k, int threads) {
+	std::vector<double> partial(threads, 0);
+	parallelFor(set.size(), threads, [&](size_t begin, size_t end, int t) {
+		double sum = 0;
+		for (size_t i = begin; i < end; i++) {
+			double error = set.result[i] - sigmoid(linearEval(set, i, weights), k);
+			sum += error * error;
+		}
+		partial[t] = sum;
+	});
+	double sum = 0;
+	for (double value : partial) {
+		sum += value;
+	}
+	return sum / set.size();
+}
+
+// Gradient of the mean squared error with respect to every weight
+static void gradient(const TuningSet& set, const double* weights, double k, int threads, std::vector<double>& result) {
+	std::vector<std::vector<double>> partial(threads, std::vector<double>(EvalWeights::COUNT, 0));
+	parallelFor(set.size(), threads, [&](size_t begin, size_t end, int t) {
+		double* grad = partial[t].data();
+		for (size_t i = begin; i < end; i++) {
+			double s = sigmoid(linearEval(set, i, weights), k);
+			double g = (s - set.result[i]) * s * (1 - s);
+			for (unsigned int j = set.offset[i]; j < set.offset[i + 1]; j++) {
+				grad[set.index[j]] += g * set.coefficient[j];
+			}
+			double phase = set.phase[i];
+			int white = set.kingSquares[2 * i], black = set.kingSquares[2 * i + 1];
+			grad[EvalWeights::KING_MIDDLE + white] += g * (1 - phase);
+			grad[EvalWeights::KING_END + white] += g * phase;
+			grad[EvalWeights::KING_MIDDLE + black] -= g * (1 - phase);
+			grad[EvalWeights::KING_END + black] -= g * phase;
+		}
+	});
+
+	// d/dw (r - s)^2 = 2 (s - r) s (1 - s) ln(10) k / 400 * d(eval)/dw
+	double scale = 2 * std::log(10.0) * k / 400 / set.size();
+	result.assign(EvalWeights::COUNT, 0);
+	for (int t = 0; t < threads; t++) {
+		for (int w = 0; w < EvalWeights::COUNT; w++) {
+			result[w] += partial[t][w] * scale;
+		}
+	}
+}
+
+// Finds the sigmoid scaling constant that best fits the current weights
+static double fitK(const TuningSet& set, const double* weights, int threads) {
+	double best = 1, bestError = totalError(set, weights, best, threads);
+	for (double step = 1; step >= 0.001; step /= 10) {
+		bool improved = true;
+		while (improved) {
+			improved = false;
+			for (double k : { best - step, best + step }) {
+				if (k <= 0) {
+					continue;
+				}
+				double error = totalError(set, weights, k, threads);
+				if (error < bestError) {
+					best = k;
+					bestError = error;
+					improved = true;
+				}
+			}
+		}
+	}
+	return best;
+}
+
+
+static void initialWeights(std::vector<double>& weights) {
+	const signed char* tables[5] = {
+		PieceSquareTables::pawnTable, PieceSquareTables::knightTable, PieceSquareTables::bishopTable,
+		PieceSquareTables::rookTable, PieceSquareTables::queenTable
+	};
+	weights.assign(EvalWeights::COUNT, 0);
+	for (int type = 0; type < 5; type++) {
+		weights[EvalWeights::VALUES + type] = PieceSquareTables::pieceValues[type + 1];
+		for (int square = 0; square < 64; square++) {
+			weights[EvalWeights::TABLES + type * 64 + square] = tables[type][square];
+		}
+	}
+	for (int square = 0; square < 64; square++) {
+		weights[EvalWeights::KING_MIDDLE + square] = PieceSquareTables::kingMiddleTable[square];
+		weights[EvalWeights::KING_END + square] = PieceSquareTables::kingEndTable[square];
+	}
+}
+
+static void writeTable(FILE* file, const char* name, const double* table) {
+	fprintf(file, "\n\tstatic constexpr signed char %s[64] = {\n", name);
+	for (int rank = 0; rank < 8; rank++) {
+		fprintf(file, "\t\t");
+		for (int column = 0; column < 8; column++) {
+			long value = std::lround(std::max(-127.0, std::min(127.0, table[rank * 8 + column])));
+			fprintf(file, "%3ld%s", value, rank == 7 && column == 7 ? "" : ",");
+		}
+		fprintf(file, "\n");
+	}
+	fprintf(file, "\t};\n");
+}
+
+// Writes the weights back out in the layout of PieceSquareTables.h
+static bool writeHeader(const char* path, const std::vector<double>& weights) {
+	FILE* file = fopen(path, "w");
+	if (file == nullptr) {
+		return false;
+	}
+	fprintf(file, "#pragma once\n\n\nstruct PieceSquareTables {\n");
+	// the tuned tables already change the evaluation fingerprint, so the version is carried over as it is
+	fprintf(file, "\t// Bump when the evaluation changes in a way these tables don't show; transposition table files remember it\n");
+	fprintf(file, "\tstatic constexpr int evalVersion = %d;\n\n", PieceSquareTables::evalVersion);
+	fprintf(file, "\t// Indexed by piece type\n\tstatic constexpr int pieceValues[7] = { 0");
+	for (int type = 0; type < 5; type++) {
+		fprintf(file, ", %ld", std::lround(weights[EvalWeights::VALUES + type]));
+	}
+	fprintf(file, ", 0 };\n");
+
+	const char* names[5] = { "pawnTable", "knightTable", "bishopTable", "rookTable", "queenTable" };
+	for (int type = 0; type < 5; type++) {
+		writeTable(file, names[type], &weights[EvalWeights::TABLES + type * 64]);
+	}
+	writeTable(file, "kingMiddleTable", &weights[EvalWeights::KING_MIDDLE]);
+	writeTable(file, "kingEndTable", &weights[EvalWeights::KING_END]);
+	fprintf(file, "};");
+	fclose(file);
+	return true;
+}
+
+
+int main(int argc, char** argv) {
+	if (argc < 5) {
+		printf("Usage: tuner <output header> <epochs> <threads> <datagen files...>\n");
+		return -1;
+	}
+	int epochs = std::stoi(argv[2]);
+	int threads = std::max(1, std::stoi(argv[3]));
+
+	auto start = std::chrono::steady_clock::now();
+	TuningSet set;
+	set.offset.push_back(0);
+	for (int i = 4; i < argc; i++) {
+		loadFile(argv[i], set);
+	}
+	if (set.size() == 0) {
+		printf("No positions loaded\n");
+		return -1;
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("Loaded %zu positions (%zu terms) in %.1fs\n", set.size(), set.index.size(), seconds);
+
+	std::vector<double> weights;
+	initialWeights(weights);
+	double k = fitK(set, weights.data(), threads);
+	printf("K: %.3f, initial error: %.6f\n", k, totalError(set, weights.data(), k, threads));
+
+	// Adam
+	const double rate = 1, beta1 = 0.9, beta2 = 0.999;
+	std::vector<double> grad, m(EvalWeights::COUNT, 0), v(EvalWeights::COUNT, 0);
+	for (int epoch = 1; epoch <= epochs; epoch++) {
+		auto epochStart = std::chrono::steady_clock::now();
+		gradient(set, weights.data(), k, threads, grad);
+		for (int w = 0; w < EvalWeights::COUNT; w++) {
+			m[w] = beta1 * m[w] + (1 - beta1) * grad[w];
+			v[w] = beta2 * v[w] + (1 - beta2) * grad[w] * grad[w];
+			double mHat = m[w] / (1 - std::pow(beta1, epoch));
+			double vHat = v[w] / (1 - std::pow(beta2, epoch));
+			weights[w] -= rate * mHat / (std::sqrt(vHat) + 1e-8);
+		}
+		seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - epochStart).count();
+		if (epoch % 10 == 0 || epoch == epochs) {
+			printf("Epoch %d: error %.6f (%.2fs/epoch)\n", epoch, totalError(set, weights.data(), k, threads), seconds);
+		}
+	}
+
+	if (!writeHeader(argv[1], weights)) {
+		printf("Could not write %s\n", argv[1]);
+		return -1;
+	}
+	printf("Wrote %s\n", argv[1]);
+	return 0;
+}